@@ -5,10 +5,18 @@
 
 #include "avl_tree.h"
 
-// Global variables
-avlnode *avlroot = NULL;
+// Lookups a batch runs side by side
+#define AVL_GROUP 16
+
+// Everything one tree owns
+struct avltree
+{
+    avlnode *root;
+    memstats mem;
+};
 
 // Function prototypes
+bool avl_ingest(void *t, int number);
 int height(avlnode *n);
 int max(int a, int b);
 struct avlnode *avl_balance(avlnode *n);
@@ -17,47 +25,83 @@ struct avlnode *rightRotate(avlnode* n);
 struct avlnode *checkBalance(avlnode *n);
 void updateHeight(avlnode *n);
 
+// Creates an empty tree, returning NULL if out of memory
+avltree *avl_create(void)
+{
+    return calloc(1, sizeof(avltree));
+}
+
+// Frees the tree and every number left in it
+void avl_destroy(avltree *t)
+{
+    if (t != NULL)
+    {
+        avl_unload(t);
+        free(t);
+    }
+}
+
 // Insert a node in the AVL tree
-bool avl_insert(const char *data_file)
+bool avl_insert(avltree *t, const char *data_file)
+{
+    mem_reset(&t->mem);
+
+    if (!ingest(data_file, avl_ingest, t))
+    {
+        avl_unload(t);
+        return false;
+    }
+    return true;
+}
+
+// Adds a single number to the tree, returning false if out of memory
+bool avl_add(avltree *t, int number)
 {
-    // open data file
-    FILE *inptr = fopen(data_file, "r");
-    if (inptr == NULL)
+    avlnode *n = mem_alloc(&t->mem, sizeof(avlnode));
+    if (n == NULL)
     {
-        printf("Could not open %s.\n", data_file);
         return false;
     }
 
-    // create a buffer
-    int buffer;
+    n->number = number;
+    n->height = 0;
+    n->left = NULL;
+    n->right = NULL;
+
+    t->root = avl_build(t, t->root, n);
+    return true;
+}
 
-    // Build list until reach the end of file
-    while(fscanf(inptr, "%i", &buffer) != EOF)
+// Adds n numbers, returning false if out of memory
+// Every insert can reshape the path the next one takes, so they run one by one
+bool avl_add_batch(avltree *t, const int *keys, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
     {
-        avlnode *n = malloc(sizeof(avlnode));
-        if (n == NULL)
+        if (!avl_add(t, keys[i]))
         {
-            avl_unload();
             return false;
         }
-
-        n->number = buffer;
-        n->height = 0;
-        n->left = NULL;
-        n->right = NULL;
-
-        avlroot = avl_build(avlroot, n);
     }
-    // Close the data file
-    fclose(inptr);
-
     return true;
 }
 
+// avl_add in the shape ingest calls it
+bool avl_ingest(void *t, int number)
+{
+    return avl_add(t, number);
+}
+
+// Returns the allocation counters of the tree
+memstats *avl_memory(avltree *t)
+{
+    return &t->mem;
+}
+
 // Search for a node in the AVL tree
-bool avl_search(int numbers)
+bool avl_search(avltree *t, int numbers)
 {
-    avlnode *n = avlroot;
+    avlnode *n = t->root;
     while (n != NULL)
     {
         // if number is greater than current node
@@ -86,43 +130,134 @@ bool avl_search(int numbers)
         }
         else
         {
-            avlroot = avl_delete(avlroot, numbers);
+            bool removed;
+            t->root = avl_delete(t, t->root, numbers, &removed);
             return true;
         }
     }
     return false;
 }
 
+// Returns true if number is in the tree, leaving the tree untouched
+bool avl_contains(avltree *t, int number)
+{
+    avlnode *n = t->root;
+    while (n != NULL)
+    {
+        if (number > n->number)
+        {
+            n = n->right;
+        }
+        else if (number < n->number)
+        {
+            n = n->left;
+        }
+        else
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Deletes number from the tree in a single descent, returning false if it wasn't there
+// (avl_search finds the number first and then descends again to delete it)
+bool avl_remove(avltree *t, int number)
+{
+    bool removed = false;
+    t->root = avl_delete(t, t->root, number, &removed);
+    return removed;
+}
+
+// Looks up n numbers, setting found[i] for each, and returns how many were found
+// Groups of AVL_GROUP lookups descend the tree in lockstep, each prefetching its
+// next node, so their cache misses overlap instead of following one another
+size_t avl_contains_batch(avltree *t, const int *keys, size_t n, bool *found)
+{
+    size_t hits = 0;
+    for (size_t base = 0; base < n; base += AVL_GROUP)
+    {
+        size_t group = (n - base < AVL_GROUP) ? n - base : AVL_GROUP;
+        avlnode *cursor[AVL_GROUP];
+        for (size_t j = 0; j < group; j++)
+        {
+            cursor[j] = t->root;
+            found[base + j] = false;
+        }
+
+        // move every lookup still running one level down
+        bool running = true;
+        while (running)
+        {
+            running = false;
+            for (size_t j = 0; j < group; j++)
+            {
+                avlnode *c = cursor[j];
+                if (c == NULL)
+                {
+                    continue;
+                }
+
+                int key = keys[base + j];
+                if (key == c->number)
+                {
+                    found[base + j] = true;
+                    hits++;
+                    cursor[j] = NULL;
+                    continue;
+                }
+
+                c = (key < c->number) ? c->left : c->right;
+                if (c != NULL)
+                {
+                    __builtin_prefetch(c);
+                    running = true;
+                }
+                cursor[j] = c;
+            }
+        }
+    }
+    return hits;
+}
+
 // Frees entire tree from memory
-void avl_unload(void)
+void avl_unload(avltree *t)
 {
-    avl_free(avlroot);
-    avlroot = NULL;
+    avl_free(t, t->root);
+    t->root = NULL;
 }
 
-// Deletes a node from the list
-struct avlnode *avl_delete(avlnode *root, int number)
+// Deletes a node from the list, setting removed if the number was found
+struct avlnode *avl_delete(avltree *t, avlnode *root, int number, bool *removed)
 {
+    // if the number isn't in the tree
+    if (root == NULL)
+    {
+        return NULL;
+    }
+
     // if value is to the left
     if (number < root->number)
     {
         // assign subroot recursively to the left value
-        root->left = avl_delete(root->left, number);
+        root->left = avl_delete(t, root->left, number, removed);
     }
     // if value is to the right
     else if (number > root->number)
     {
             // assign subroot recursively to the right value
-        root->right = avl_delete(root->right, number);
+        root->right = avl_delete(t, root->right, number, removed);
     }
 
     // if value is found
     else
     {
+        *removed = true;
+
         // edge case leaf node
         if (root->left == NULL && root->right == NULL)
         {
-            free(root);
+            mem_free(&t->mem, root, sizeof(avlnode));
             return NULL;
         }
 
@@ -131,7 +266,7 @@ struct avlnode *avl_delete(avlnode *root, int number)
         {
             // free the node and assign the child to the parent node
             avlnode *child = (root->left != NULL) ? root->left : root->right;
-            free(root);
+            mem_free(&t->mem, root, sizeof(avlnode));
             return child;
         }
         // node with two children
@@ -164,7 +299,7 @@ struct avlnode *avl_delete(avlnode *root, int number)
             }
 
             // free the successor node
-            free(smallest);
+            mem_free(&t->mem, smallest, sizeof(avlnode));
             return root;
         }
     }
@@ -176,7 +311,7 @@ struct avlnode *avl_delete(avlnode *root, int number)
 }
 
 // Creates trees nodes
-struct avlnode *avl_build(avlnode* current, avlnode* new)
+struct avlnode *avl_build(avltree *t, avlnode* current, avlnode* new)
 {
     // if list is empty
     if (current == NULL)
@@ -200,7 +335,7 @@ struct avlnode *avl_build(avlnode* current, avlnode* new)
 
         }
         // recursively try to find an available node and assign it to the left child
-        current->left = avl_build(current->left, new);
+        current->left = avl_build(t, current->left, new);
     }
 
     else if (new->number > current->number)
@@ -217,12 +352,12 @@ struct avlnode *avl_build(avlnode* current, avlnode* new)
             return current;
         }
         // recursively try to find an available node and assign it to the right child
-        current->right = avl_build(current->right, new);
+        current->right = avl_build(t, current->right, new);
     }
     // If the number already exists in the list, don't assign it to anything
     else
     {
-        free(new);
+        mem_free(&t->mem, new, sizeof(avlnode));
         return current;
     }
 
@@ -234,15 +369,15 @@ struct avlnode *avl_build(avlnode* current, avlnode* new)
 }
 
 // Frees entire tree from memory
-void avl_free(avlnode *n)
+void avl_free(avltree *t, avlnode *n)
 {
     if (n == NULL)
     {
         return;
     }
-    avl_free(n->left);
-    avl_free(n->right);
-    free(n);
+    avl_free(t, n->left);
+    avl_free(t, n->right);
+    mem_free(&t->mem, n, sizeof(avlnode));
 }
 
 // Return the height of a node
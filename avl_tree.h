@@ -5,6 +5,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "ingest.h"
+#include "memory.h"
+
 typedef struct avlnode
 {
     int number;
@@ -13,11 +16,22 @@ typedef struct avlnode
     struct avlnode *right;
 } avlnode;
 
-bool avl_insert(const char *data_file);
-bool avl_search(int numbers);
-void avl_unload(void);
-struct avlnode *avl_delete(avlnode *root, int number);
-struct avlnode *avl_build(avlnode* current, avlnode* new);
-void avl_free(avlnode *n);
+// A tree, only handled through the functions below
+typedef struct avltree avltree;
+
+avltree *avl_create(void);
+void avl_destroy(avltree *t);
+bool avl_insert(avltree *t, const char *data_file);
+bool avl_add(avltree *t, int number);
+bool avl_add_batch(avltree *t, const int *keys, size_t n);
+memstats *avl_memory(avltree *t);
+bool avl_search(avltree *t, int numbers);
+bool avl_contains(avltree *t, int number);
+size_t avl_contains_batch(avltree *t, const int *keys, size_t n, bool *found);
+bool avl_remove(avltree *t, int number);
+void avl_unload(avltree *t);
+struct avlnode *avl_delete(avltree *t, avlnode *root, int number, bool *removed);
+struct avlnode *avl_build(avltree *t, avlnode* current, avlnode* new);
+void avl_free(avltree *t, avlnode *n);
 
 #endif
@@ -0,0 +1,196 @@
+// Blocked Bloom filter that answers "definitely absent" for most numbers
+// that were never added, without touching the structure behind it
+
+// A plain Bloom filter scatters a number's bits over the whole array, so a
+// lookup costs one cache miss per hash function. Here a number's bits all
+// lie in one 512-bit block, picked by the top half of a 64-bit hash. The
+// bottom half places them inside it: each bit is the top 9 bits of that
+// half times an odd constant of its own. A lookup costs one cache miss,
+// and a miss usually stops at its first clear bit
+
+// Double hashing inside the block (bit i at a + i * b) was tried first, but
+// its positions are too alike across numbers: at 16 bits per number it let
+// through 0.22% instead of the predicted 0.09%
+
+// Blocks fill up unevenly, which costs some false positives over a plain
+// filter of the same size, so the size is chosen from the false positive
+// rate a blocked filter actually reaches: the numbers per block follow a
+// Poisson distribution, and the rate is averaged over it
+
+// Numbers can't be taken out again, so a number deleted from the structure
+// still passes the filter
+
+#define _DEFAULT_SOURCE
+
+#include "bloom.h"
+
+// Everything one filter owns
+struct bloom
+{
+    uint64_t *words;
+    size_t blocks;
+    int hashes;
+    // bits per number and false positive rate it was sized for
+    double bits;
+    double rate;
+};
+
+// Multipliers picking the bit of every hash function inside a block
+// (Impala's split block filter's eight, then the golden ratio's, MurmurHash3's, xxHash's and lowbias32's)
+const uint32_t bloom_salts[BLOOM_MAX_HASHES] = {
+    0x47b6137b, 0x44974d91, 0x8824ad5b, 0xa2b7289d, 0x705495c7, 0x2df1424b, 0x9efc4947, 0x5c6bfb31,
+    0x9e3779b9, 0x85ebca6b, 0xc2b2ae35, 0xcc9e2d51, 0x1b873593, 0x27d4eb2f, 0x165667b1, 0x7feb352d};
+
+// Function prototypes
+double bloom_predict(double bits, int hashes);
+uint64_t bloom_hash(int number);
+const uint64_t *bloom_block(const bloom *b, uint64_t h);
+
+// Creates an empty filter for keys numbers that lets through at most
+// rate of the numbers never added, counting its bits against m
+// Returns NULL if out of memory
+bloom *bloom_create(size_t keys, double rate, memstats *m)
+{
+    bloom *b = malloc(sizeof(bloom));
+    if (b == NULL)
+    {
+        return NULL;
+    }
+
+    // start from the size a plain filter would need, and grow it until a
+    // blocked one gets there too, with whichever number of hashes does best
+    b->bits = ceil(-log(rate) / (M_LN2 * M_LN2));
+    b->hashes = 1;
+    b->rate = 1.0;
+    for (; b->bits <= BLOOM_MAX_BITS; b->bits += 0.25)
+    {
+        int best = (int) round(b->bits * M_LN2);
+        for (int k = best - 1; k <= best + 1; k++)
+        {
+            double predicted = bloom_predict(b->bits, k);
+            if (k >= 1 && k <= BLOOM_MAX_HASHES && predicted < b->rate)
+            {
+                b->hashes = k;
+                b->rate = predicted;
+            }
+        }
+        if (b->rate <= rate)
+        {
+            break;
+        }
+    }
+    b->bits = fmin(b->bits, BLOOM_MAX_BITS);
+
+    b->blocks = (size_t) ceil(keys * b->bits / BLOOM_BLOCK_BITS);
+    b->blocks = (b->blocks > 0) ? b->blocks : 1;
+    b->words = aligned_alloc(BLOOM_BLOCK_BITS / 8, bloom_bytes(b));
+    if (b->words == NULL)
+    {
+        free(b);
+        return NULL;
+    }
+    memset(b->words, 0, bloom_bytes(b));
+    mem_count(m, bloom_bytes(b));
+    return b;
+}
+
+// Frees the filter, counting its bits as freed against m
+void bloom_destroy(bloom *b, memstats *m)
+{
+    if (b != NULL)
+    {
+        mem_free(m, b->words, bloom_bytes(b));
+        free(b);
+    }
+}
+
+// Sets the bits of a number
+void bloom_add(bloom *b, int number)
+{
+    uint64_t h = bloom_hash(number);
+    uint64_t *block = (uint64_t *) bloom_block(b, h);
+    for (int i = 0; i < b->hashes; i++)
+    {
+        uint32_t bit = ((uint32_t) h * bloom_salts[i]) >> (32 - BLOOM_BLOCK_SHIFT);
+        block[bit / 64] |= UINT64_C(1) << (bit % 64);
+    }
+}
+
+// Returns false if number was never added, and true if it probably was
+bool bloom_contains(const bloom *b, int number)
+{
+    uint64_t h = bloom_hash(number);
+    const uint64_t *block = bloom_block(b, h);
+    for (int i = 0; i < b->hashes; i++)
+    {
+        uint32_t bit = ((uint32_t) h * bloom_salts[i]) >> (32 - BLOOM_BLOCK_SHIFT);
+        if ((block[bit / 64] & (UINT64_C(1) << (bit % 64))) == 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Starts loading the block of a number that is about to be looked up
+void bloom_prefetch(const bloom *b, int number)
+{
+    __builtin_prefetch(bloom_block(b, bloom_hash(number)));
+}
+
+// Returns the size of the filter's bits
+size_t bloom_bytes(const bloom *b)
+{
+    return b->blocks * (BLOOM_BLOCK_BITS / 8);
+}
+
+// Returns the bits the filter spends on every number it was sized for
+double bloom_bits(const bloom *b)
+{
+    return b->bits;
+}
+
+// Returns how many bits every number sets
+int bloom_hashes(const bloom *b)
+{
+    return b->hashes;
+}
+
+// Returns the false positive rate predicted once the filter holds the numbers it was sized for
+double bloom_rate(const bloom *b)
+{
+    return b->rate;
+}
+
+// Predicts the false positive rate of a blocked filter with bits bits per
+// number and hashes bits set by each, averaged over how many numbers a
+// block holds
+double bloom_predict(double bits, int hashes)
+{
+    double mean = BLOOM_BLOCK_BITS / bits;
+    double clear = 1.0 - 1.0 / BLOOM_BLOCK_BITS;
+    double chance = exp(-mean), rate = 0;
+    for (int i = 0; i < mean + 10 * sqrt(mean) + 10; i++)
+    {
+        // with i numbers in the block, a bit is set with probability 1 - clear^(hashes * i)
+        rate += chance * pow(1.0 - pow(clear, (double) hashes * i), hashes);
+        chance *= mean / (i + 1);
+    }
+    return rate;
+}
+
+// Mixes a number into 64 bits (the splitmix64 finalizer), independently of
+// the hash the structure behind the filter uses
+uint64_t bloom_hash(int number)
+{
+    uint64_t x = (uint32_t) number + UINT64_C(0x9e3779b97f4a7c15);
+    x = (x ^ (x >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+    x = (x ^ (x >> 27)) * UINT64_C(0x94d049bb133111eb);
+    return x ^ (x >> 31);
+}
+
+// Returns the block a hash picks with its top 32 bits
+const uint64_t *bloom_block(const bloom *b, uint64_t h)
+{
+    return b->words + ((h >> 32) * b->blocks >> 32) * BLOOM_BLOCK_WORDS;
+}
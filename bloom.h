@@ -0,0 +1,34 @@
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "memory.h"
+
+// Bits of a block, one cache line: every number's bits lie in one block
+#define BLOOM_BLOCK_SHIFT 9
+#define BLOOM_BLOCK_BITS (1 << BLOOM_BLOCK_SHIFT)
+#define BLOOM_BLOCK_WORDS (BLOOM_BLOCK_BITS / 64)
+
+// Most hash functions (bits set per number) and bits per number a filter uses
+#define BLOOM_MAX_HASHES 16
+#define BLOOM_MAX_BITS 64
+
+// A blocked Bloom filter over ints, only handled through the functions below
+typedef struct bloom bloom;
+
+bloom *bloom_create(size_t keys, double rate, memstats *m);
+void bloom_destroy(bloom *b, memstats *m);
+void bloom_add(bloom *b, int number);
+bool bloom_contains(const bloom *b, int number);
+void bloom_prefetch(const bloom *b, int number);
+size_t bloom_bytes(const bloom *b);
+double bloom_bits(const bloom *b);
+int bloom_hashes(const bloom *b);
+double bloom_rate(const bloom *b);
+
+#endif
@@ -5,57 +5,131 @@
 
 #include "bst.h"
 
-// Global variables
-bstnode *root = NULL;
+// Lookups a batch runs side by side
+#define BST_GROUP 16
 
-bool bst_insert(const char *data_file)
+// Everything one tree owns
+struct bst
 {
-    // open data file
-    FILE *inptr = fopen(data_file, "r");
-    if (inptr == NULL)
+    bstnode *root;
+    memstats mem;
+};
+
+// Function prototypes
+bool bst_ingest(void *t, int number);
+
+// Creates an empty tree, returning NULL if out of memory
+bst *bst_create(void)
+{
+    return calloc(1, sizeof(bst));
+}
+
+// Frees the tree and every number left in it
+void bst_destroy(bst *t)
+{
+    if (t != NULL)
     {
-        printf("Could not open %s.\n", data_file);
+        bst_unload(t);
+        free(t);
+    }
+}
+
+bool bst_insert(bst *t, const char *data_file)
+{
+    mem_reset(&t->mem);
+
+    if (!ingest(data_file, bst_ingest, t))
+    {
+        bst_unload(t);
         return false;
     }
+    return true;
+}
 
-    // create a buffer
-    int buffer;
+// Adds a single number to the tree, returning false if out of memory
+bool bst_add(bst *t, int number)
+{
+    bstnode *n = mem_alloc(&t->mem, sizeof(bstnode));
+    if (n == NULL)
+    {
+        return false;
+    }
+
+    n->number = number;
+    n->left = NULL;
+    n->right = NULL;
+
+    // If list is empty
+    if (t->root == NULL)
+    {
+        t->root = n;
+    }
+
+    else
+    {
+        bst_build(t->root, n);
+    }
+    return true;
+}
 
-    // Build list until reach the end of file
-    while(fscanf(inptr, "%i", &buffer) != EOF)
+// Adds n numbers, returning false if out of memory
+// Every insert can reshape the path the next one takes, so they run one by one
+bool bst_add_batch(bst *t, const int *keys, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
     {
-        bstnode *n = malloc(sizeof(bstnode));
-        if (n == NULL)
+        if (!bst_add(t, keys[i]))
         {
-            bst_unload();
             return false;
         }
+    }
+    return true;
+}
 
-        n->number = buffer;
-        n->left = NULL;
-        n->right = NULL;
+// bst_add in the shape ingest calls it
+bool bst_ingest(void *t, int number)
+{
+    return bst_add(t, number);
+}
+
+// Returns the allocation counters of the tree
+memstats *bst_memory(bst *t)
+{
+    return &t->mem;
+}
 
-        // If list is empty
-        if (root == NULL)
+// Searches for a number and deletes it if found, the benchmark's fused operation
+bool bst_search(bst *t, int numbers)
+{
+    return bst_remove(t, numbers);
+}
+
+// Returns true if number is in the tree, leaving the tree untouched
+bool bst_contains(bst *t, int number)
+{
+    bstnode *n = t->root;
+    while (n != NULL)
+    {
+        if (number > n->number)
         {
-            root = n;
+            n = n->right;
+        }
+        else if (number < n->number)
+        {
+            n = n->left;
         }
-
         else
         {
-            bst_build(root, n);
+            return true;
         }
     }
-    // Close the data file
-    fclose(inptr);
-
-    return true;
+    return false;
 }
 
-
-bool bst_search(int numbers)
+// Deletes number from the tree, returning false if it wasn't there
+bool bst_remove(bst *t, int numbers)
 {
-    bstnode *n = root, *parent = NULL;
+    bstnode *n = t->root, *parent = NULL;
     while (n != NULL)
     {
         // if number is greater than current node
@@ -86,20 +160,72 @@ bool bst_search(int numbers)
         }
         else
         {
-            bst_delete(n, parent);
+            bst_delete(t, n, parent);
             return true;
         }
     }
     return false;
 }
 
-void bst_unload(void)
+// Looks up n numbers, setting found[i] for each, and returns how many were found
+// Groups of BST_GROUP lookups descend the tree in lockstep, each prefetching its
+// next node, so their cache misses overlap instead of following one another
+size_t bst_contains_batch(bst *t, const int *keys, size_t n, bool *found)
+{
+    size_t hits = 0;
+    for (size_t base = 0; base < n; base += BST_GROUP)
+    {
+        size_t group = (n - base < BST_GROUP) ? n - base : BST_GROUP;
+        bstnode *cursor[BST_GROUP];
+        for (size_t j = 0; j < group; j++)
+        {
+            cursor[j] = t->root;
+            found[base + j] = false;
+        }
+
+        // move every lookup still running one level down
+        bool running = true;
+        while (running)
+        {
+            running = false;
+            for (size_t j = 0; j < group; j++)
+            {
+                bstnode *c = cursor[j];
+                if (c == NULL)
+                {
+                    continue;
+                }
+
+                int key = keys[base + j];
+                if (key == c->number)
+                {
+                    found[base + j] = true;
+                    hits++;
+                    cursor[j] = NULL;
+                    continue;
+                }
+
+                c = (key < c->number) ? c->left : c->right;
+                if (c != NULL)
+                {
+                    __builtin_prefetch(c);
+                    running = true;
+                }
+                cursor[j] = c;
+            }
+        }
+    }
+    return hits;
+}
+
+void bst_unload(bst *t)
 {
-    bst_free(root);
+    bst_free(t, t->root);
+    t->root = NULL;
 }
 
 // Deletes a node from the list
-void bst_delete(bstnode *n, bstnode *parent)
+void bst_delete(bst *t, bstnode *n, bstnode *parent)
 {
 
     // edge case leaf node
@@ -108,9 +234,9 @@ void bst_delete(bstnode *n, bstnode *parent)
         // if it's the root node, just free it
         if (parent == NULL)
         {
-            free(n);
+            mem_free(&t->mem, n, sizeof(bstnode));
             // reset root to NULL to avoid memory issue
-            root = NULL;
+            t->root = NULL;
             return;
         }
         else
@@ -123,7 +249,7 @@ void bst_delete(bstnode *n, bstnode *parent)
             {
                 parent->right = NULL;
             }
-            free(n);
+            mem_free(&t->mem, n, sizeof(bstnode));
         }
     }
 
@@ -137,7 +263,7 @@ void bst_delete(bstnode *n, bstnode *parent)
         // if the node is a root
         if (parent == NULL)
         {
-            root = child;
+            t->root = child;
         }
 
         // if node is not a root
@@ -153,7 +279,7 @@ void bst_delete(bstnode *n, bstnode *parent)
             }
         }
 
-        free(n);
+        mem_free(&t->mem, n, sizeof(bstnode));
     }
     // node with two children
     else
@@ -182,7 +308,7 @@ void bst_delete(bstnode *n, bstnode *parent)
         }
 
         // free the successor node
-        free(smallest);
+        mem_free(&t->mem, smallest, sizeof(bstnode));
     }
 }
 
@@ -211,14 +337,14 @@ void bst_build(bstnode* current, bstnode* new)
 }
 
 // Frees entire tree from memory
-void bst_free(bstnode *n)
+void bst_free(bst *t, bstnode *n)
 {
     if (n == NULL)
     {
         return;
     }
-    bst_free(n->left);
-    bst_free(n->right);
-    free(n);
+    bst_free(t, n->left);
+    bst_free(t, n->right);
+    mem_free(&t->mem, n, sizeof(bstnode));
 }
 
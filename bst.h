@@ -5,6 +5,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "ingest.h"
+#include "memory.h"
+
 typedef struct bstnode
 {
     int number;
@@ -12,11 +15,22 @@ typedef struct bstnode
     struct bstnode *right;
 } bstnode;
 
-bool bst_insert(const char *data_file);
-bool bst_search(int numbers);
-void bst_unload(void);
-void bst_delete(bstnode *n, bstnode *parent);
+// A tree, only handled through the functions below
+typedef struct bst bst;
+
+bst *bst_create(void);
+void bst_destroy(bst *t);
+bool bst_insert(bst *t, const char *data_file);
+bool bst_add(bst *t, int number);
+bool bst_add_batch(bst *t, const int *keys, size_t n);
+memstats *bst_memory(bst *t);
+bool bst_search(bst *t, int numbers);
+bool bst_contains(bst *t, int number);
+size_t bst_contains_batch(bst *t, const int *keys, size_t n, bool *found);
+bool bst_remove(bst *t, int number);
+void bst_unload(bst *t);
+void bst_delete(bst *t, bstnode *n, bstnode *parent);
 void bst_build(bstnode* current, bstnode* new);
-void bst_free(bstnode *n);
+void bst_free(bst *t, bstnode *n);
 
 #endif
@@ -0,0 +1,282 @@
+// Hardware performance counters around the benchmark phases
+
+// Events are opened with perf_event_open in two groups, one for the core
+// (cycles, instructions, branch misses) and one for the memory hierarchy
+// (L1D, LLC and dTLB misses), so each group always fits the PMU and its
+// ratios come from the same stretch of time. Only user space of the calling
+// thread is counted, which the default perf_event_paranoid level allows
+
+// Events the CPU or kernel doesn't offer are left out and reported as "-",
+// and if none can be opened the benchmark runs without counters
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "counters.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#define COUNTER_GROUPS 2
+
+// Function prototypes
+int counter_open(int event, int leader);
+void counter_explain(int error);
+
+// Global variables
+int counter_fd[COUNTER_EVENTS];
+int counter_leader[COUNTER_GROUPS] = {-1, -1};
+
+// Group each event belongs to
+const int counter_group[COUNTER_EVENTS] = {0, 0, 0, 1, 1, 1};
+
+// Opens every event the machine supports, returning false if there are none
+bool counters_open(void)
+{
+    int error = 0;
+    bool any = false;
+
+    for (int g = 0; g < COUNTER_GROUPS; g++)
+    {
+        counter_leader[g] = -1;
+    }
+
+    for (int e = 0; e < COUNTER_EVENTS; e++)
+    {
+        // the first event of a group that opens leads it
+        int g = counter_group[e];
+        counter_fd[e] = counter_open(e, counter_leader[g]);
+        if (counter_fd[e] < 0)
+        {
+            if (error == 0)
+            {
+                error = errno;
+            }
+            continue;
+        }
+
+        if (counter_leader[g] < 0)
+        {
+            counter_leader[g] = counter_fd[e];
+        }
+        any = true;
+    }
+
+    if (!any)
+    {
+        counter_explain(error);
+    }
+    return any;
+}
+
+// Resets and starts every group
+void counters_start(void)
+{
+#ifdef __linux__
+    for (int g = 0; g < COUNTER_GROUPS; g++)
+    {
+        if (counter_leader[g] >= 0)
+        {
+            ioctl(counter_leader[g], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(counter_leader[g], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+    }
+#endif
+}
+
+// Stops every group and reads its events into c
+void counters_stop(counts *c)
+{
+    memset(c, 0, sizeof(counts));
+
+#ifdef __linux__
+    for (int g = 0; g < COUNTER_GROUPS; g++)
+    {
+        if (counter_leader[g] >= 0)
+        {
+            ioctl(counter_leader[g], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        }
+    }
+
+    for (int g = 0; g < COUNTER_GROUPS; g++)
+    {
+        if (counter_leader[g] < 0)
+        {
+            continue;
+        }
+
+        // nr, time enabled, time running, then one value per open member
+        uint64_t data[3 + COUNTER_EVENTS];
+        if (read(counter_leader[g], data, sizeof(data)) < (ssize_t) (3 * sizeof(uint64_t)))
+        {
+            continue;
+        }
+
+        // a group that never got onto the PMU has nothing to report
+        if (data[2] == 0)
+        {
+            continue;
+        }
+        double scale = (double) data[1] / data[2];
+
+        // members come back in the order they joined the group
+        uint64_t i = 0;
+        for (int e = 0; e < COUNTER_EVENTS && i < data[0]; e++)
+        {
+            if (counter_group[e] == g && counter_fd[e] >= 0)
+            {
+                c->values[e] = (uint64_t) (data[3 + i] * scale);
+                c->valid[e] = true;
+                i++;
+            }
+        }
+    }
+#endif
+}
+
+// Closes every event
+void counters_close(void)
+{
+    for (int e = 0; e < COUNTER_EVENTS; e++)
+    {
+        if (counter_fd[e] >= 0)
+        {
+            close(counter_fd[e]);
+            counter_fd[e] = -1;
+        }
+    }
+    for (int g = 0; g < COUNTER_GROUPS; g++)
+    {
+        counter_leader[g] = -1;
+    }
+}
+
+// Prints one phase's events per operation
+void counters_print(const counts *c, const char *phase, size_t ops)
+{
+    printf("%-8s", phase);
+
+    double per = (ops > 0) ? 1.0 / ops : 0.0;
+    const int order[] = {COUNTER_CYCLES, COUNTER_INSTRUCTIONS};
+    for (int i = 0; i < 2; i++)
+    {
+        if (c->valid[order[i]])
+        {
+            printf(" %11.1f", c->values[order[i]] * per);
+        }
+        else
+        {
+            printf(" %11s", "-");
+        }
+    }
+
+    // instructions per cycle
+    if (c->valid[COUNTER_CYCLES] && c->valid[COUNTER_INSTRUCTIONS] && c->values[COUNTER_CYCLES] > 0)
+    {
+        printf(" %6.2f", (double) c->values[COUNTER_INSTRUCTIONS] / c->values[COUNTER_CYCLES]);
+    }
+    else
+    {
+        printf(" %6s", "-");
+    }
+
+    for (int e = COUNTER_BRANCH_MISSES; e < COUNTER_EVENTS; e++)
+    {
+        if (c->valid[e])
+        {
+            printf(" %11.3f", c->values[e] * per);
+        }
+        else
+        {
+            printf(" %11s", "-");
+        }
+    }
+    printf("\n");
+}
+
+// Opens a single event, in the group of leader unless it is -1
+int counter_open(int event, int leader)
+{
+#ifdef __linux__
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    // members follow their leader, which starts disabled
+    attr.disabled = (leader < 0);
+
+    switch (event)
+    {
+        case COUNTER_CYCLES:
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case COUNTER_INSTRUCTIONS:
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case COUNTER_BRANCH_MISSES:
+            attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+        case COUNTER_LLC_MISSES:
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+            break;
+        case COUNTER_L1D_MISSES:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+        case COUNTER_DTLB_MISSES:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+    }
+
+    // this thread, any CPU
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+// Tells the user why no counters could be opened
+void counter_explain(int error)
+{
+    if (error == EACCES || error == EPERM)
+    {
+        int level = -1;
+        FILE *f = fopen("/proc/sys/kernel/perf_event_paranoid", "r");
+        if (f != NULL)
+        {
+            if (fscanf(f, "%d", &level) != 1)
+            {
+                level = -1;
+            }
+            fclose(f);
+        }
+        printf("Hardware counters are not allowed (perf_event_paranoid is %d, needs 2 or less).\n", level);
+    }
+    else if (error == ENOSYS)
+    {
+        printf("Hardware counters are not supported on this system.\n");
+    }
+    else if (error == ENOENT || error == ENODEV || error == EOPNOTSUPP)
+    {
+        printf("This CPU exposes no hardware counters (virtual machines often don't).\n");
+    }
+    else
+    {
+        printf("No hardware counters available (%s).\n", strerror(error));
+    }
+}
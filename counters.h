@@ -0,0 +1,30 @@
+#ifndef COUNTERS_H
+#define COUNTERS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Hardware events counted around each phase
+#define COUNTER_CYCLES 0
+#define COUNTER_INSTRUCTIONS 1
+#define COUNTER_BRANCH_MISSES 2
+#define COUNTER_L1D_MISSES 3
+#define COUNTER_LLC_MISSES 4
+#define COUNTER_DTLB_MISSES 5
+#define COUNTER_EVENTS 6
+
+// Event counts of one phase, scaled up if the kernel had to multiplex them
+typedef struct counts
+{
+    uint64_t values[COUNTER_EVENTS];
+    bool valid[COUNTER_EVENTS];
+} counts;
+
+bool counters_open(void);
+void counters_start(void);
+void counters_stop(counts *c);
+void counters_close(void);
+void counters_print(const counts *c, const char *phase, size_t ops);
+
+#endif
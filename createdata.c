@@ -2,45 +2,229 @@
 // to a file chosen by the user.
 // Does not overwrite existing files.
 
+// Usage ./createdata [-b] [-s | -r] directory/[FILENAME]
+//   -b  write the binary dataset format described in dataset.h instead of text
+//   -s  sort the numbers in ascending order
+//   -r  sort the numbers in descending order
+
+// Usage ./createdata -c source/file directory/[FILENAME]
+//   converts an existing dataset to the binary format, keeping its order
+
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
+#include "dataset.h"
+#include "reader.h"
+
 #define DATASET_SIZE 10000000
 
+// Function prototypes
+FILE *create(const char *filename);
+unsigned int detect_order(const int *numbers, size_t count);
+int ascending(const void *a, const void *b);
+int descending(const void *a, const void *b);
+bool write_text(FILE *dst, const int *numbers, size_t count);
+bool write_binary(FILE *dst, const int *numbers, size_t count, unsigned int order);
+
 int main(int argc, char *argv[])
 {
-    if (argc != 2)
+    bool binary = false;
+    unsigned int order = DATASET_UNSORTED;
+    const char *source = NULL;
+
+    // read the flags before the filename
+    int arg = 1;
+    for (; arg < argc - 1 && argv[arg][0] == '-'; arg++)
+    {
+        if (strcmp(argv[arg], "-b") == 0)
+        {
+            binary = true;
+        }
+        else if (strcmp(argv[arg], "-s") == 0)
+        {
+            order = DATASET_ASCENDING;
+        }
+        else if (strcmp(argv[arg], "-r") == 0)
+        {
+            order = DATASET_DESCENDING;
+        }
+        else if (strcmp(argv[arg], "-c") == 0 && arg + 1 < argc - 1)
+        {
+            source = argv[++arg];
+            binary = true;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if (arg != argc - 1 || (source != NULL && order != DATASET_UNSORTED))
     {
-        printf("Usage ./createdata directory/[FILENAME]\n");
+        printf("Usage ./createdata [-b] [-s | -r] directory/[FILENAME]\n");
+        printf("      ./createdata -c source/file directory/[FILENAME]\n");
         return 1;
     }
 
+    int *numbers;
+    size_t count;
+    if (source != NULL)
+    {
+        numbers = reader_load(source, &count);
+        if (numbers == NULL)
+        {
+            printf("Could not convert %s!\n", source);
+            return 3;
+        }
+        order = detect_order(numbers, count);
+    }
+    else
+    {
+        count = DATASET_SIZE;
+        numbers = malloc(count * sizeof(int));
+        if (numbers == NULL)
+        {
+            printf("Not enough memory for %i numbers!\n", DATASET_SIZE);
+            return 3;
+        }
+
+        // seed the random function to get new values every time the program is run
+        srand(time(NULL));
+
+        for (size_t i = 0; i < count; i++)
+        {
+            numbers[i] = rand();
+        }
+
+        // replaces post-processing the file with sort -n / sort -nr
+        if (order == DATASET_ASCENDING)
+        {
+            qsort(numbers, count, sizeof(int), ascending);
+        }
+        else if (order == DATASET_DESCENDING)
+        {
+            qsort(numbers, count, sizeof(int), descending);
+        }
+    }
+
+    FILE *dst = create(argv[arg]);
+    if (dst == NULL)
+    {
+        free(numbers);
+        return 2;
+    }
+
+    bool written = binary ? write_binary(dst, numbers, count, order)
+                          : write_text(dst, numbers, count);
+    free(numbers);
+
+    if (fclose(dst) != 0 || !written)
+    {
+        printf("Could not write %s file!\n", argv[arg]);
+        return 3;
+    }
+    return 0;
+}
+
+// Opens a new file for writing, refusing to overwrite an existing one
+FILE *create(const char *filename)
+{
     // check if that file exists
-    FILE *dst = fopen(argv[1], "r");
+    FILE *dst = fopen(filename, "r");
     if (dst != NULL)
     {
         fclose(dst);
-        printf("The filename %s is already being used!\n", argv[1]);
-        return 2;
+        printf("The filename %s is already being used!\n", filename);
+        return NULL;
     }
-    dst = fopen(argv[1], "w");
+    dst = fopen(filename, "wb");
 
     if (dst == NULL)
     {
-        printf("Could not open %s file!\n", argv[1]);
-        return 3;
+        printf("Could not open %s file!\n", filename);
+        return NULL;
     }
+    return dst;
+}
 
-    // seed the random function to get new values every time the program is run
-    srand(time(NULL));
+// Finds out whether the numbers are already sorted in either direction
+unsigned int detect_order(const int *numbers, size_t count)
+{
+    bool up = true, down = true;
+    for (size_t i = 1; i < count && (up || down); i++)
+    {
+        if (numbers[i] < numbers[i - 1])
+        {
+            up = false;
+        }
+        if (numbers[i] > numbers[i - 1])
+        {
+            down = false;
+        }
+    }
 
-    for (int count = 0; count < DATASET_SIZE; count++)
+    if (up)
     {
-        int random = rand();
-        fprintf(dst, "%d\n", random);
+        return DATASET_ASCENDING;
     }
+    return down ? DATASET_DESCENDING : DATASET_UNSORTED;
+}
 
-    fclose(dst);
-    return 0;
+// Comparison functions for qsort
+int ascending(const void *a, const void *b)
+{
+    int x = *(const int *) a, y = *(const int *) b;
+    return (x > y) - (x < y);
+}
+
+int descending(const void *a, const void *b)
+{
+    return ascending(b, a);
+}
+
+// Writes one number per line
+bool write_text(FILE *dst, const int *numbers, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (fprintf(dst, "%d\n", numbers[i]) < 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Writes the header followed by every number as a little-endian 32 bit key
+bool write_binary(FILE *dst, const int *numbers, size_t count, unsigned int order)
+{
+    unsigned char header[DATASET_HEADER_SIZE];
+    memcpy(header, DATASET_MAGIC, DATASET_MAGIC_SIZE);
+    dataset_put64(header + 8, count);
+    dataset_put32(header + 16, sizeof(int));
+    dataset_put32(header + 20, order);
+
+    if (fwrite(header, sizeof(header), 1, dst) != 1)
+    {
+        return false;
+    }
+
+    // encode the keys in chunks to keep the number of writes down
+    unsigned char chunk[4096 * sizeof(int)];
+    for (size_t i = 0; i < count; i += 4096)
+    {
+        size_t n = (count - i < 4096) ? count - i : 4096;
+        for (size_t j = 0; j < n; j++)
+        {
+            dataset_put32(chunk + j * sizeof(int), (uint32_t) numbers[i + j]);
+        }
+        if (fwrite(chunk, sizeof(int), n, dst) != n)
+        {
+            return false;
+        }
+    }
+    return true;
 }
@@ -0,0 +1,521 @@
+// Bucketized cuckoo hash table that loads a dataset, searches and deletes specific values,
+// and finally deletes the remainder of the dataset from memory
+
+// Every number has two candidate buckets of 4 slots, picked by two halves
+// of one 64-bit hash, and is always in one of them, so a lookup compares
+// at most 8 slots (two 16-byte SSE2 compares) plus a small stash, however
+// full the table is. When both buckets are full, an insert searches
+// breadth-first for the shortest chain of numbers that can each move to
+// their other bucket and ends in a free slot, then shifts them along it.
+// If that search fails the number waits in the stash, and once the stash
+// is full too the table doubles
+
+// 0 marks an empty slot, which lets the array come zeroed from calloc;
+// the key 0 itself is kept in a flag next to the array
+
+// After loading, the table prints its load factor, how many numbers are
+// in the stash, the longest chain of moves an insert made and how often
+// the table doubled
+
+// Like the AVL tree, the table holds each number once
+
+#include "cuckoo.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Everything one table owns
+struct cktable
+{
+    int *slots;
+    size_t buckets;
+    size_t count;
+    bool zero;
+    int stash[CK_STASH];
+    size_t stashed;
+    // since loading: times the table doubled, and the longest chain of moves
+    size_t resizes;
+    size_t longestPath;
+    memstats mem;
+};
+
+// One bucket reached by the breadth-first search, with the entry of the
+// bucket it was reached from and the slot there whose number moves into it
+typedef struct ckstep
+{
+    size_t bucket;
+    int parent;
+    int slot;
+} ckstep;
+
+// How many lookups a batch runs side by side, and how far ahead batched inserts prefetch
+#define CK_GROUP 16
+#define CK_PREFETCH 8
+
+// Function prototypes
+bool ck_ingest(void *t, int number);
+void ck_pair(const cktable *t, int number, size_t *first, size_t *second);
+int ck_slot(const int *bucket, int number);
+bool ck_find(const cktable *t, int number);
+bool ck_place_free(cktable *t, int number);
+bool ck_place(cktable *t, int number);
+bool ck_resize(cktable *t, size_t buckets);
+void ck_statistics(const cktable *t);
+
+// Global variables
+double ck_max_load = CK_MAX_LOAD;
+
+// Creates an empty table, returning NULL if out of memory
+// The slot array is allocated with the first number
+cktable *ck_create(void)
+{
+    return calloc(1, sizeof(cktable));
+}
+
+// Frees the table and every number left in it
+void ck_destroy(cktable *t)
+{
+    if (t != NULL)
+    {
+        ck_unload(t);
+        free(t);
+    }
+}
+
+// Sets the share of slots every table may fill before doubling,
+// returning false if it is out of range
+bool ck_load(double load)
+{
+    if (load < 0.1 || load > 0.99)
+    {
+        return false;
+    }
+    ck_max_load = load;
+    return true;
+}
+
+// Loads database into memory, returning true if successful, else false
+bool ck_insert(cktable *t, const char *data_file)
+{
+    mem_reset(&t->mem);
+    t->resizes = 0;
+    t->longestPath = 0;
+
+    if (!ingest(data_file, ck_ingest, t))
+    {
+        ck_unload(t);
+        return false;
+    }
+
+    // Print how full the table got and what it took
+    ck_statistics(t);
+    return true;
+}
+
+// Adds a single number to the table, returning false if out of memory
+bool ck_add(cktable *t, int number)
+{
+    if (number == 0)
+    {
+        t->count += !t->zero;
+        t->zero = true;
+        return true;
+    }
+
+    if (t->slots == NULL && !ck_resize(t, CK_MIN_BUCKETS))
+    {
+        return false;
+    }
+    if (ck_find(t, number))
+    {
+        return true;
+    }
+
+    // grow before the table gets too full for short eviction chains
+    if (t->count + 1 > t->buckets * CK_SLOTS * ck_max_load && !ck_resize(t, t->buckets * 2))
+    {
+        return false;
+    }
+
+    // no chain of moves frees a slot: stash the number, or double and retry
+    while (!ck_place(t, number))
+    {
+        if (t->stashed < CK_STASH)
+        {
+            t->stash[t->stashed++] = number;
+            break;
+        }
+        if (!ck_resize(t, t->buckets * 2))
+        {
+            return false;
+        }
+    }
+    t->count++;
+    return true;
+}
+
+// Adds n numbers, returning false if out of memory
+// The first bucket of the key CK_PREFETCH places ahead is prefetched while
+// the current key is placed
+bool ck_add_batch(cktable *t, const int *keys, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        if (i + CK_PREFETCH < n && t->slots != NULL)
+        {
+            size_t first, second;
+            ck_pair(t, keys[i + CK_PREFETCH], &first, &second);
+            __builtin_prefetch(&t->slots[first * CK_SLOTS], 1);
+        }
+        if (!ck_add(t, keys[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// ck_add in the shape ingest calls it
+bool ck_ingest(void *t, int number)
+{
+    return ck_add(t, number);
+}
+
+// Returns the allocation counters of the table
+memstats *ck_memory(cktable *t)
+{
+    return &t->mem;
+}
+
+// Searches for a number and deletes it if found, the benchmark's fused operation
+bool ck_search(cktable *t, int numbers)
+{
+    return ck_remove(t, numbers);
+}
+
+// Returns true if number is in the table, leaving the table untouched
+bool ck_contains(cktable *t, int number)
+{
+    if (number == 0 || t->slots == NULL)
+    {
+        return number == 0 && t->zero;
+    }
+    return ck_find(t, number);
+}
+
+// Looks up n numbers, setting found[i] for each, and returns how many were found
+// Both buckets of a group of CK_GROUP keys are prefetched before any of
+// them is compared, so their cache misses overlap
+size_t ck_contains_batch(cktable *t, const int *keys, size_t n, bool *found)
+{
+    size_t hits = 0;
+    for (size_t base = 0; base < n; base += CK_GROUP)
+    {
+        size_t group = (n - base < CK_GROUP) ? n - base : CK_GROUP;
+        if (t->slots != NULL)
+        {
+            for (size_t j = 0; j < group; j++)
+            {
+                size_t first, second;
+                ck_pair(t, keys[base + j], &first, &second);
+                __builtin_prefetch(&t->slots[first * CK_SLOTS]);
+                __builtin_prefetch(&t->slots[second * CK_SLOTS]);
+            }
+        }
+        for (size_t j = 0; j < group; j++)
+        {
+            found[base + j] = ck_contains(t, keys[base + j]);
+            hits += found[base + j];
+        }
+    }
+    return hits;
+}
+
+// Deletes number from the table, returning false if it wasn't there
+bool ck_remove(cktable *t, int number)
+{
+    if (number == 0 || t->slots == NULL)
+    {
+        if (number != 0 || !t->zero)
+        {
+            return false;
+        }
+        t->zero = false;
+        t->count--;
+        return true;
+    }
+
+    size_t first, second;
+    ck_pair(t, number, &first, &second);
+    int i = ck_slot(&t->slots[first * CK_SLOTS], number);
+    int j = (i < 0) ? ck_slot(&t->slots[second * CK_SLOTS], number) : -1;
+    if (i < 0 && j < 0)
+    {
+        // a stashed number is replaced by the last one of the stash
+        for (size_t s = 0; s < t->stashed; s++)
+        {
+            if (t->stash[s] == number)
+            {
+                t->stash[s] = t->stash[--t->stashed];
+                t->count--;
+                return true;
+            }
+        }
+        return false;
+    }
+    t->slots[(i >= 0) ? first * CK_SLOTS + i : second * CK_SLOTS + j] = 0;
+
+    // the free slot may let a stashed number back into the table
+    for (size_t s = 0; s < t->stashed; )
+    {
+        if (ck_place_free(t, t->stash[s]))
+        {
+            t->stash[s] = t->stash[--t->stashed];
+        }
+        else
+        {
+            s++;
+        }
+    }
+    t->count--;
+    return true;
+}
+
+// Frees the slot array, leaving an empty table
+void ck_unload(cktable *t)
+{
+    if (t->slots != NULL)
+    {
+        mem_free(&t->mem, t->slots, t->buckets * CK_SLOTS * sizeof(int));
+    }
+    t->slots = NULL;
+    t->buckets = 0;
+    t->count = 0;
+    t->zero = false;
+    t->stashed = 0;
+}
+
+// The two candidate buckets of a number: the low and high halves of a
+// 64-bit mix of it, each scaled down to the number of buckets
+void ck_pair(const cktable *t, int number, size_t *first, size_t *second)
+{
+    uint64_t h = (uint64_t) (uint32_t) number * 0x9E3779B97F4A7C15ull;
+    h ^= h >> 32;
+    h *= 0xD6E8FEB86659FD93ull;
+    h ^= h >> 32;
+    *first = (size_t) (((h & 0xFFFFFFFFu) * t->buckets) >> 32);
+    *second = (size_t) (((h >> 32) * t->buckets) >> 32);
+}
+
+// Returns the slot of a bucket holding number, or -1 if none does
+int ck_slot(const int *bucket, int number)
+{
+#if defined(__SSE2__)
+    __m128i slots = _mm_loadu_si128((const __m128i *) bucket);
+    int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(slots, _mm_set1_epi32(number))));
+    return (mask != 0) ? __builtin_ctz(mask) : -1;
+#else
+    for (int i = 0; i < CK_SLOTS; i++)
+    {
+        if (bucket[i] == number)
+        {
+            return i;
+        }
+    }
+    return -1;
+#endif
+}
+
+// Returns true if number is in one of its buckets or the stash
+bool ck_find(const cktable *t, int number)
+{
+    size_t first, second;
+    ck_pair(t, number, &first, &second);
+
+    if (ck_slot(&t->slots[first * CK_SLOTS], number) >= 0 || ck_slot(&t->slots[second * CK_SLOTS], number) >= 0)
+    {
+        return true;
+    }
+
+    for (size_t s = 0; s < t->stashed; s++)
+    {
+        if (t->stash[s] == number)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Puts a number into a free slot of one of its buckets, returning false if both are full
+bool ck_place_free(cktable *t, int number)
+{
+    size_t first, second;
+    ck_pair(t, number, &first, &second);
+
+    int i = ck_slot(&t->slots[first * CK_SLOTS], 0);
+    if (i >= 0)
+    {
+        t->slots[first * CK_SLOTS + i] = number;
+        return true;
+    }
+    i = ck_slot(&t->slots[second * CK_SLOTS], 0);
+    if (i >= 0)
+    {
+        t->slots[second * CK_SLOTS + i] = number;
+        return true;
+    }
+    return false;
+}
+
+// Puts a number known not to be in the table into one of its buckets,
+// moving other numbers to their other bucket to free a slot if needed,
+// returning false if no chain of moves within CK_BFS_MAX buckets does
+bool ck_place(cktable *t, int number)
+{
+    if (ck_place_free(t, number))
+    {
+        return true;
+    }
+
+    // breadth-first search from both buckets, so the chain found is the shortest
+    ckstep queue[CK_BFS_MAX];
+    int tail = 0;
+    size_t first, second;
+    ck_pair(t, number, &first, &second);
+    queue[tail++] = (ckstep) {first, -1, -1};
+    queue[tail++] = (ckstep) {second, -1, -1};
+
+    for (int head = 0; head < tail; head++)
+    {
+        size_t bucket = queue[head].bucket;
+        for (int s = 0; s < CK_SLOTS; s++)
+        {
+            size_t a, b;
+            ck_pair(t, t->slots[bucket * CK_SLOTS + s], &a, &b);
+            size_t other = (a == bucket) ? b : a;
+            if (other == bucket)
+            {
+                continue;
+            }
+
+            int free = ck_slot(&t->slots[other * CK_SLOTS], 0);
+            if (free < 0)
+            {
+                if (tail < CK_BFS_MAX)
+                {
+                    queue[tail++] = (ckstep) {other, head, s};
+                }
+                continue;
+            }
+
+            // a chain through the same bucket twice could move a number that
+            // was already moved, so only chains of distinct buckets are used
+            bool repeated = false;
+            size_t moves = 0;
+            for (int i = head; i >= 0; i = queue[i].parent, moves++)
+            {
+                for (int j = queue[i].parent; j >= 0; j = queue[j].parent)
+                {
+                    repeated = repeated || queue[j].bucket == queue[i].bucket;
+                }
+            }
+            if (repeated)
+            {
+                continue;
+            }
+
+            // shift every number of the chain one step on, from the free slot back
+            t->slots[other * CK_SLOTS + free] = t->slots[bucket * CK_SLOTS + s];
+            size_t hole = bucket * CK_SLOTS + s;
+            for (int i = head; queue[i].parent >= 0; i = queue[i].parent)
+            {
+                size_t from = queue[queue[i].parent].bucket * CK_SLOTS + queue[i].slot;
+                t->slots[hole] = t->slots[from];
+                hole = from;
+            }
+            t->slots[hole] = number;
+
+            if (moves > t->longestPath)
+            {
+                t->longestPath = moves;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+// Moves every number into a new array of buckets buckets, doubling again
+// while they don't all fit, returning false if out of memory
+bool ck_resize(cktable *t, size_t buckets)
+{
+    int *old = t->slots;
+    size_t oldBuckets = t->buckets;
+    int stash[CK_STASH];
+    size_t stashed = t->stashed;
+    for (size_t i = 0; i < stashed; i++)
+    {
+        stash[i] = t->stash[i];
+    }
+
+    while (true)
+    {
+        int *slots = mem_calloc(&t->mem, buckets * CK_SLOTS, sizeof(int));
+        if (slots == NULL)
+        {
+            t->slots = old;
+            t->buckets = oldBuckets;
+            t->stashed = stashed;
+            for (size_t i = 0; i < stashed; i++)
+            {
+                t->stash[i] = stash[i];
+            }
+            return false;
+        }
+        t->slots = slots;
+        t->buckets = buckets;
+        t->stashed = 0;
+
+        // place the numbers of the old array, then of the old stash
+        bool fits = true;
+        for (size_t i = 0; i < oldBuckets * CK_SLOTS + stashed && fits; i++)
+        {
+            int number = (i < oldBuckets * CK_SLOTS) ? old[i] : stash[i - oldBuckets * CK_SLOTS];
+            if (number != 0 && !ck_place(t, number))
+            {
+                fits = t->stashed < CK_STASH;
+                if (fits)
+                {
+                    t->stash[t->stashed++] = number;
+                }
+            }
+        }
+        if (fits)
+        {
+            break;
+        }
+        mem_free(&t->mem, slots, buckets * CK_SLOTS * sizeof(int));
+        buckets *= 2;
+    }
+
+    if (old != NULL)
+    {
+        mem_free(&t->mem, old, oldBuckets * CK_SLOTS * sizeof(int));
+        t->resizes++;
+    }
+    return true;
+}
+
+// Prints the load factor, the stash, the longest chain of moves and the resizes
+void ck_statistics(const cktable *t)
+{
+    size_t slots = t->buckets * CK_SLOTS;
+    printf("     =============\n");
+    printf("     CUCKOO\n");
+    printf("     load = %.3f (max %.2f), %zu stashed, longest chain of moves = %zu, %zu resizes\n",
+           slots > 0 ? (double) (t->count - t->zero) / slots : 0.0, ck_max_load, t->stashed,
+           t->longestPath, t->resizes);
+    printf("     =============\n");
+}
@@ -0,0 +1,44 @@
+#ifndef CUCKOO_H
+#define CUCKOO_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ingest.h"
+#include "memory.h"
+
+// Slots per bucket, 16 bytes of ints
+#define CK_SLOTS 4
+
+// Smallest table, in buckets (a power of two)
+#define CK_MIN_BUCKETS 256
+
+// Default share of slots used before the table doubles; four slots per
+// bucket let cuckoo hashing fill well past 90% before inserts start failing
+#define CK_MAX_LOAD 0.95
+
+// Numbers that found no place kept aside and checked by every lookup
+#define CK_STASH 8
+
+// Buckets an insert may search for a free slot before it gives up
+#define CK_BFS_MAX 512
+
+// A bucketized cuckoo hash table, only handled through the functions below
+typedef struct cktable cktable;
+
+cktable *ck_create(void);
+void ck_destroy(cktable *t);
+bool ck_load(double load);
+bool ck_insert(cktable *t, const char *data_file);
+bool ck_add(cktable *t, int number);
+bool ck_add_batch(cktable *t, const int *keys, size_t n);
+memstats *ck_memory(cktable *t);
+bool ck_search(cktable *t, int numbers);
+bool ck_contains(cktable *t, int number);
+size_t ck_contains_batch(cktable *t, const int *keys, size_t n, bool *found);
+bool ck_remove(cktable *t, int number);
+void ck_unload(cktable *t);
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef DATASET_H
+#define DATASET_H
+
+#include <stdint.h>
+
+// Binary dataset layout, every field little-endian:
+//   8 bytes   magic "EFFDAT01"
+//   8 bytes   number of keys
+//   4 bytes   width of each key in bytes
+//   4 bytes   order of the keys
+// followed by the keys themselves, each one 'width' bytes wide
+#define DATASET_MAGIC "EFFDAT01"
+#define DATASET_MAGIC_SIZE 8
+#define DATASET_HEADER_SIZE 24
+
+// Order of the keys in a binary dataset
+#define DATASET_UNSORTED 0
+#define DATASET_ASCENDING 1
+#define DATASET_DESCENDING 2
+
+// Reads a little-endian 32 bit value
+static inline uint32_t dataset_get32(const unsigned char *p)
+{
+    return (uint32_t) p[0] | (uint32_t) p[1] << 8 |
+           (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+// Reads a little-endian 64 bit value
+static inline uint64_t dataset_get64(const unsigned char *p)
+{
+    return (uint64_t) dataset_get32(p) | (uint64_t) dataset_get32(p + 4) << 32;
+}
+
+// Writes a little-endian 32 bit value
+static inline void dataset_put32(unsigned char *p, uint32_t value)
+{
+    p[0] = value;
+    p[1] = value >> 8;
+    p[2] = value >> 16;
+    p[3] = value >> 24;
+}
+
+// Writes a little-endian 64 bit value
+static inline void dataset_put64(unsigned char *p, uint64_t value)
+{
+    dataset_put32(p, (uint32_t) value);
+    dataset_put32(p + 4, (uint32_t) (value >> 32));
+}
+
+#endif
@@ -12,94 +12,180 @@
 
 #include "doub_linkedlist.h"
 
-// Global variables
-dllnode *dllhead = NULL;
-dllnode *dlltail = NULL;
+// Everything one list owns
+struct dll
+{
+    dllnode *head;
+    dllnode *tail;
+    memstats mem;
+};
+
+// Function prototypes
+bool dll_ingest(void *l, int number);
+
+// Creates an empty list, returning NULL if out of memory
+dll *dll_create(void)
+{
+    return calloc(1, sizeof(dll));
+}
+
+// Frees the list and every number left in it
+void dll_destroy(dll *l)
+{
+    if (l != NULL)
+    {
+        dll_unload(l);
+        free(l);
+    }
+}
 
 // Inserts the dataset into the doubly linked list
-bool dll_insert(const char *data_file)
+bool dll_insert(dll *l, const char *data_file)
 {
-        // open data file
-        FILE *inptr = fopen(data_file, "r");
-        if (inptr == NULL)
-        {
-            printf("Could not open %s.\n", data_file);
-            return false;
-        }
+    mem_reset(&l->mem);
+
+    if (!ingest(data_file, dll_ingest, l))
+    {
+        dll_unload(l);
+        return false;
+    }
+    return true;
+}
+
+// Adds a single number to the sorted list, returning false if out of memory
+bool dll_add(dll *l, int number)
+{
+    dllnode *n = mem_alloc(&l->mem, sizeof(dllnode));
+    if (n == NULL)
+    {
+        return false;
+    }
+
+    n->prev = NULL;
+    n->next = NULL;
+    n->number = number;
+
+    // if list is empty
+    if (l->head == NULL)
+    {
+        l->head = n;
+        l->tail = n;
+    }
 
-        // create a buffer
-        int buffer;
+    // If number belongs at beginning of list
+    else if (n->number < l->head->number)
+    {
+        n->next = l->head;
+        l->head->prev = n;
+        l->head = n;
+    }
 
-        // Build list until reach the end of file
-        while(fscanf(inptr, "%i", &buffer) != EOF)
+    // If number is greater than or equal to
+    // the tail, append to the end of the list
+    else if (n->number >= l->tail->number)
+    {
+        l->tail->next = n;
+        n->prev = l->tail;
+        l->tail = n;
+    }
+
+    // If number belongs in the middle of the list
+    else
+    {
+        // Iterate over nodes in list
+        for (dllnode *cursor = l->head; cursor != NULL; cursor = cursor->next)
         {
-            dllnode *n = malloc(sizeof(dllnode));
-            if (n == NULL)
+            // if current number is smaller than the next number
+            if (n->number < cursor->next->number)
             {
-                dll_unload();
-                return false;
+                n->next = cursor->next;
+                n->prev = cursor;
+                cursor->next->prev = n;
+                cursor->next = n;
+                break;
             }
+        }
+    }
+    return true;
+}
 
-            n->prev = NULL;
-            n->next = NULL;
-            n->number = buffer;
+// Adds n numbers, returning false if out of memory
+// Each insert walks the list on its own
+bool dll_add_batch(dll *l, const int *keys, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        if (!dll_add(l, keys[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
 
-            // if list is empty
-            if (dllhead == NULL)
-            {
-                dllhead = n;
-                dlltail = n;
-            }
+// dll_add in the shape ingest calls it
+bool dll_ingest(void *l, int number)
+{
+    return dll_add(l, number);
+}
 
-            // If number belongs at beginning of list
-            else if (n->number < dllhead->number)
-            {
-                n->next = dllhead;
-                dllhead->prev = n;
-                dllhead = n;
-            }
+// Returns the allocation counters of the list
+memstats *dll_memory(dll *l)
+{
+    return &l->mem;
+}
 
-            // If number is greater than or equal to
-            // the tail, append to the end of the list
-            else if (n->number >= dlltail->number)
-            {
-                dlltail->next = n;
-                n->prev = dlltail;
-                dlltail = n;
-            }
+// Searches for a number and deletes it if found, the benchmark's fused operation
+bool dll_search(dll *l, int numbers)
+{
+    return dll_remove(l, numbers);
+}
 
-            // If number belongs in the middle of the list
-            else
+// Returns true if number is in the list, leaving the list untouched
+bool dll_contains(dll *l, int number)
+{
+    for (dllnode *n = l->head; n != NULL; n = n->next)
+    {
+        if (n->number == number)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Looks up n numbers, setting found[i] for each, and returns how many were found
+// The whole batch is answered in one walk over the list instead of one walk per number
+size_t dll_contains_batch(dll *l, const int *keys, size_t n, bool *found)
+{
+    size_t hits = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        found[i] = false;
+    }
+
+    for (dllnode *c = l->head; c != NULL && hits < n; c = c->next)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            if (!found[i] && keys[i] == c->number)
             {
-                // Iterate over nodes in list
-                for (dllnode *cursor = dllhead; cursor != NULL; cursor = cursor->next)
-                {
-                    // if current number is smaller than the next number
-                    if (n->number < cursor->next->number)
-                    {
-                        n->next = cursor->next;
-                        n->prev = cursor;
-                        cursor->next->prev = n;
-                        cursor->next = n;
-                        break;
-                    }
-                }
+                found[i] = true;
+                hits++;
             }
         }
-        // Close the data file
-        fclose(inptr);
-
-    return true;
+    }
+    return hits;
 }
 
-// Searches a node to be deleted from the list
-bool dll_search(int numbers)
+// Deletes number from the list, returning false if it wasn't there
+bool dll_remove(dll *l, int numbers)
 {
-    for (dllnode *n = dllhead; n != NULL; n = n->next)
+    for (dllnode *n = l->head; n != NULL; n = n->next)
     {
         if (n->number == numbers)
         {
-            dll_delete(n);
+            dll_delete(l, n);
             return true;
         }
     }
@@ -107,22 +193,24 @@ bool dll_search(int numbers)
 }
 
 // Unloads all memory allocated
-void dll_unload(void)
+void dll_unload(dll *l)
 {
     // access the head of the linked list
-    dllnode *n = dllhead;
+    dllnode *n = l->head;
 
     // free memory inside the linked list until all values are NULL
     while (n != NULL)
     {
         dllnode *temp = n->next;
-        free(n);
+        mem_free(&l->mem, n, sizeof(dllnode));
         n = temp;
     }
+    l->head = NULL;
+    l->tail = NULL;
 }
 
 // Deletes a node from the list
-void dll_delete(dllnode *n)
+void dll_delete(dll *l, dllnode *n)
 {
     // if n is head
     if (n->prev == NULL)
@@ -131,31 +219,31 @@ void dll_delete(dllnode *n)
         if (n->next == NULL)
         {
             // reset head and tail back to null
-            dllhead = NULL;
-            dlltail = NULL;
+            l->head = NULL;
+            l->tail = NULL;
         }
         // if there are other values
         else
         {
             // move the head pointer to the next value
-            dllhead = n->next;
+            l->head = n->next;
             // reset head prev pointer to null
-            dllhead->prev = NULL;
+            l->head->prev = NULL;
         }
 
-        free(n);
+        mem_free(&l->mem, n, sizeof(dllnode));
     }
     // if n is tail
     else if(n->next == NULL)
     {
-        dlltail = n->prev;
-        dlltail->next = NULL;
-        free(n);
+        l->tail = n->prev;
+        l->tail->next = NULL;
+        mem_free(&l->mem, n, sizeof(dllnode));
     }
     else
     {
         n->prev->next = n->next;
         n->next->prev = n->prev;
-        free(n);
+        mem_free(&l->mem, n, sizeof(dllnode));
     }
 }
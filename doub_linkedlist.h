@@ -5,6 +5,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "ingest.h"
+#include "memory.h"
+
 // Represents a node in a linked list
 typedef struct dllnode
 {
@@ -13,9 +16,20 @@ typedef struct dllnode
     struct dllnode *next;
 } dllnode;
 
-bool dll_insert(const char *data_file);
-bool dll_search(int numbers);
-void dll_unload(void);
-void dll_delete(dllnode *n);
+// A list, only handled through the functions below
+typedef struct dll dll;
+
+dll *dll_create(void);
+void dll_destroy(dll *l);
+bool dll_insert(dll *l, const char *data_file);
+bool dll_add(dll *l, int number);
+bool dll_add_batch(dll *l, const int *keys, size_t n);
+memstats *dll_memory(dll *l);
+bool dll_search(dll *l, int numbers);
+bool dll_contains(dll *l, int number);
+size_t dll_contains_batch(dll *l, const int *keys, size_t n, bool *found);
+bool dll_remove(dll *l, int number);
+void dll_unload(dll *l);
+void dll_delete(dll *l, dllnode *n);
 
 #endif
@@ -1,13 +1,63 @@
 // C program to test efficiency of different structures
 // with large datasets
-// Usage ./efficiency dataset/file.txt numbers/file.txt [structure]
+// Usage ./efficiency [options] dataset/file.txt numbers/file.txt [structure]
+//   -p    load the dataset through a reader thread (pipelined ingest)
+//   -b    preload the search file and time the whole search loop at once
+//   -s N  also time every Nth insert and search on its own and print
+//         their latency percentiles
+//   -r N  harness mode: repeat the whole benchmark N times (default 5) and
+//         report median, MAD and a 95% confidence interval per phase
+//   -w N  harness mode: unmeasured warmup runs first (default 1)
+//   -c N  pin the benchmark to CPU N
+//   -q M  what the search phase does with every query: "fused" searches
+//         and deletes it (the default), "lookup" only checks that it is
+//         there, "delete" removes it through the separate remove call
+//   -B N  read the dataset into memory first and insert it N keys at a
+//         time through the batch calls, and with -q lookup look the
+//         queries up N at a time too; -B 1 runs the single-key calls on
+//         the same preloaded keys, for comparison (implies -b)
+//   -e    count cycles, instructions, branch, cache and TLB misses in
+//         each phase with perf_event_open and print them per operation
+//   -H F  hash function of the chained hash table: fibonacci (the
+//         default), murmur3, xxh3 or crc32c
+//   -L F  let the open addressing, Robin Hood, Swiss and cuckoo tables
+//         fill this share of their slots before they grow (by default
+//         0.7, 0.9, 0.875 and 0.95)
+//   -o F  harness mode: write the results to F, appended as CSV if F ends
+//         in .csv, else as JSON
+//   -F P  put a blocked Bloom filter in front of the structure, sized for
+//         a false positive rate of P (e.g. 0.01) and filled while the
+//         dataset loads; queries it rules out never reach the structure,
+//         and the run prints how many that was
+//   -T N  split the search file between 1, 2, 4 ... N threads searching one
+//         instance at once, reloading it for every thread count, and print
+//         the throughput and speedup of each (thread-safe structures only;
+//         with -c C, thread i is pinned to CPU C + i); the sharded table
+//         instead gets 1, 2, 4 ... N shards, each with a thread of its own,
+//         and the main thread routes every query to them in batches (with
+//         -c C, shard i is pinned to CPU C + 1 + i, as it is without -T)
+
+// Usage ./efficiency -m [-t S] [dataset/ search/]
+//   runs every structure against the random, sorted and reversed files of
+//   both directories, each in a fresh child process killed after S seconds
+//   (default 60), and prints the comparison table
+
+// Usage ./efficiency -g [-t S] dataset/file.txt numbers/file.txt [structure]
+//   sweeps the structure (or every structure) over 1K, 2K, 5K, 10K...
+//   key prefixes of the files, each size in its own child, and prints
+//   ns/op and bytes per key for every size
+
+#define _DEFAULT_SOURCE
+
 #include <ctype.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
 #include <sys/resource.h>
 #include <sys/time.h>
+#include <time.h>
 
 // Include structure headers
 #include "sing_linkedlist.h"
@@ -16,31 +66,333 @@
 #include "avl_tree.h"
 #include "hashing.h"
 #include "trie.h"
+#include "open_addressing.h"
+#include "robin_hood.h"
+#include "swiss_table.h"
+#include "cuckoo.h"
+#include "striped_hash.h"
+#include "lockfree_hash.h"
+#include "sharded_hash.h"
+#include "bloom.h"
+#include "reader.h"
+#include "latency.h"
+#include "harness.h"
+#include "matrix.h"
+#include "counters.h"
 
 // Default database
 #define DATABASE "dataset/random.txt"
 
+// Structure codes, in the order the matrix runs them
+const char *structures[] = {"h", "oa", "rh", "sw", "ck", "sh", "lf", "sd", "bst", "avl", "t", "sll", "dll", NULL};
 
-// Function prototypes
-double calculate(const struct rusage *b, const struct rusage *a);
+// Structures that many threads can search at once
+const char *concurrent[] = {"sh", "lf", NULL};
+
+// Keys ahead a batched lookup prefetches the filter's blocks
+#define FILTER_PREFETCH 8
 
+// Search phase modes
+#define QUERY_FUSED 0
+#define QUERY_LOOKUP 1
+#define QUERY_DELETE 2
+const char *query_modes[] = {"fused", "lookup", "delete", NULL};
+
+// Every structure is driven through a handle to one of its instances
 typedef struct {
-    bool (*insert)(const char *filename);
-    bool (*search)(int number);
-    void (*unload)(void);
+    void *(*create)(void);
+    void (*destroy)(void *s);
+    bool (*insert)(void *s, const char *filename);
+    bool (*add)(void *s, int number);
+    bool (*add_batch)(void *s, const int *keys, size_t n);
+    bool (*search)(void *s, int number);
+    bool (*contains)(void *s, int number);
+    size_t (*contains_batch)(void *s, const int *keys, size_t n, bool *found);
+    bool (*remove)(void *s, int number);
+    void (*unload)(void *s);
+    memstats *(*memory)(void *s);
+    // prints the resizes since the last report under a phase, NULL if the structure has none to report
+    void (*resizes)(void *s, const char *phase);
 } structure_ops;
 
+// Wraps a module's functions, which take its own handle type, into a structure_ops
+#define STRUCTURE(prefix)                                                                              \
+    void *prefix##_op_create(void) { return prefix##_create(); }                                       \
+    void prefix##_op_destroy(void *s) { prefix##_destroy(s); }                                         \
+    bool prefix##_op_insert(void *s, const char *filename) { return prefix##_insert(s, filename); }    \
+    bool prefix##_op_add(void *s, int number) { return prefix##_add(s, number); }                      \
+    bool prefix##_op_add_batch(void *s, const int *keys, size_t n)                                     \
+    {                                                                                                  \
+        return prefix##_add_batch(s, keys, n);                                                         \
+    }                                                                                                  \
+    bool prefix##_op_search(void *s, int number) { return prefix##_search(s, number); }                \
+    bool prefix##_op_contains(void *s, int number) { return prefix##_contains(s, number); }            \
+    size_t prefix##_op_contains_batch(void *s, const int *keys, size_t n, bool *found)                 \
+    {                                                                                                  \
+        return prefix##_contains_batch(s, keys, n, found);                                             \
+    }                                                                                                  \
+    bool prefix##_op_remove(void *s, int number) { return prefix##_remove(s, number); }                \
+    void prefix##_op_unload(void *s) { prefix##_unload(s); }                                           \
+    memstats *prefix##_op_memory(void *s) { return prefix##_memory(s); }                               \
+    const structure_ops prefix##_ops = {prefix##_op_create, prefix##_op_destroy, prefix##_op_insert,   \
+                                        prefix##_op_add, prefix##_op_add_batch, prefix##_op_search,      \
+                                        prefix##_op_contains, prefix##_op_contains_batch,                \
+                                        prefix##_op_remove, prefix##_op_unload, prefix##_op_memory, NULL};
+
+STRUCTURE(sll)
+STRUCTURE(dll)
+STRUCTURE(bst)
+STRUCTURE(avl)
+STRUCTURE(hash)
+STRUCTURE(trie)
+STRUCTURE(oa)
+STRUCTURE(rh)
+STRUCTURE(sw)
+STRUCTURE(ck)
+STRUCTURE(sh)
+STRUCTURE(lf)
+STRUCTURE(sd)
+
+void hash_op_resizes(void *s, const char *phase) { hash_resizes(s, phase); }
+void sd_op_resizes(void *s, const char *phase) { sd_resizes(s, phase); }
+
+typedef bool (*query_fn)(void *s, int number);
+
+// One thread of a threaded search, and its share of the queries
+typedef struct worker
+{
+    pthread_t thread;
+    query_fn query;
+    void *s;
+    const int *queries;
+    size_t count;
+    size_t notFound;
+    int cpu;
+    // held for writing until every thread is ready to start
+    pthread_rwlock_t *gate;
+} worker;
+
+// A structure with a Bloom filter in front of it (-F), and what the filter saved
+typedef struct filtered
+{
+    void *s;
+    bloom *filter;
+    // the filter's bits, and what filter_memory adds up with the structure's
+    memstats mem;
+    memstats total;
+    // how the last filter was sized, kept for the report after unloading
+    size_t expected;
+    size_t bytes;
+    double bits;
+    int hashes;
+    double rate;
+    // queries, the ones the filter ruled out, and the ones it let through that weren't there
+    size_t queries;
+    size_t rejected;
+    size_t wasted;
+    // the keys of a batch that got past the filter, their places in it and their results
+    int *keys;
+    size_t *where;
+    bool *found;
+    size_t room;
+} filtered;
+
+// Global variables
+int query_mode = QUERY_FUSED;
+double filter_rate = 0.0;
+structure_ops filter_inner;
+
+// Function prototypes
+bool select_structure(const char *name, structure_ops *ops);
+query_fn select_query(const structure_ops *ops);
+double calculate(const struct rusage *b, const struct rusage *a);
+double elapsed(const struct timespec *b, const struct timespec *a);
+bool sampled_search(query_fn query, void *s, int number, histogram *h);
+bool insert_batches(structure_ops *ops, void *s, const int *keys, size_t count, int batch);
+int harness(structure_ops *ops, harness_run *run, const char *output);
+bool run_pass(structure_ops *ops, void *s, const char *data_file, const int *queries, size_t count,
+              double phases[HARNESS_PHASES], size_t *notFound, size_t *bytes);
+bool run_cell(const char *structure, const char *data_file, const char *search_file, size_t limit, cell *c);
+void print_memory(const char *structure, const memstats *m, size_t loaded, size_t keys);
+int scaling(structure_ops *ops, const char *structure, const char *data, const char *search, int threads, int cpu);
+void *scaling_worker(void *arg);
+void *filter_create(void);
+void filter_destroy(void *s);
+bool filter_insert(void *s, const char *filename);
+bool filter_add(void *s, int number);
+bool filter_add_batch(void *s, const int *keys, size_t n);
+bool filter_search(void *s, int number);
+bool filter_contains(void *s, int number);
+size_t filter_contains_batch(void *s, const int *keys, size_t n, bool *found);
+bool filter_remove(void *s, int number);
+void filter_unload(void *s);
+memstats *filter_memory(void *s);
+void filter_resizes(void *s, const char *phase);
+bool filter_expect(void *s, size_t keys);
+void filter_tap(void *s, int number);
+bool filter_query(filtered *f, query_fn query, int number);
+bool filter_room(filtered *f, size_t n);
+void filter_print(void *s);
+
 
 int main(int argc, char *argv[])
 {
+    // Read the flags before the file names
+    bool pipelined = false, bulk = false, events = false;
+    int sample = 0, batch = 0, threads = 0;
+    int repetitions = 0, warmup = -1, cpu = -1;
+    char *output = NULL;
+    bool matrix = false, sweep = false;
+    int timeout = 60;
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-'; arg++)
+    {
+        if (strcmp(argv[arg], "-p") == 0)
+        {
+            pipelined = true;
+        }
+        else if (strcmp(argv[arg], "-b") == 0)
+        {
+            bulk = true;
+        }
+        else if (strcmp(argv[arg], "-s") == 0 && arg + 1 < argc && atoi(argv[arg + 1]) > 0)
+        {
+            sample = atoi(argv[++arg]);
+        }
+        else if (strcmp(argv[arg], "-r") == 0 && arg + 1 < argc && atoi(argv[arg + 1]) > 0)
+        {
+            repetitions = atoi(argv[++arg]);
+        }
+        else if (strcmp(argv[arg], "-w") == 0 && arg + 1 < argc && isdigit(argv[arg + 1][0]))
+        {
+            warmup = atoi(argv[++arg]);
+        }
+        else if (strcmp(argv[arg], "-c") == 0 && arg + 1 < argc && isdigit(argv[arg + 1][0]))
+        {
+            cpu = atoi(argv[++arg]);
+        }
+        else if (strcmp(argv[arg], "-q") == 0 && arg + 1 < argc)
+        {
+            for (query_mode = 0; query_modes[query_mode] != NULL; query_mode++)
+            {
+                if (strcmp(argv[arg + 1], query_modes[query_mode]) == 0)
+                {
+                    break;
+                }
+            }
+            if (query_modes[query_mode] == NULL)
+            {
+                printf("Unknown search mode: %s\n", argv[arg + 1]);
+                return 1;
+            }
+            arg++;
+        }
+        else if (strcmp(argv[arg], "-B") == 0 && arg + 1 < argc && atoi(argv[arg + 1]) > 0)
+        {
+            batch = atoi(argv[++arg]);
+            bulk = true;
+        }
+        else if (strcmp(argv[arg], "-e") == 0)
+        {
+            events = true;
+        }
+        else if (strcmp(argv[arg], "-H") == 0 && arg + 1 < argc)
+        {
+            if (!hashfn_select(hashfn_find(argv[arg + 1])))
+            {
+                printf("Unknown or unsupported hash function: %s\n", argv[arg + 1]);
+                return 1;
+            }
+            arg++;
+        }
+        else if (strcmp(argv[arg], "-L") == 0 && arg + 1 < argc)
+        {
+            double load = atof(argv[arg + 1]);
+            if (!oa_load(load) || !rh_load(load) || !sw_load(load) || !ck_load(load))
+            {
+                printf("Load factor must be between 0.1 and 0.99: %s\n", argv[arg + 1]);
+                return 1;
+            }
+            arg++;
+        }
+        else if (strcmp(argv[arg], "-m") == 0)
+        {
+            matrix = true;
+        }
+        else if (strcmp(argv[arg], "-g") == 0)
+        {
+            sweep = true;
+        }
+        else if (strcmp(argv[arg], "-t") == 0 && arg + 1 < argc && atoi(argv[arg + 1]) > 0)
+        {
+            timeout = atoi(argv[++arg]);
+        }
+        else if (strcmp(argv[arg], "-o") == 0 && arg + 1 < argc)
+        {
+            output = argv[++arg];
+        }
+        else if (strcmp(argv[arg], "-F") == 0 && arg + 1 < argc)
+        {
+            filter_rate = atof(argv[++arg]);
+            if (filter_rate <= 0 || filter_rate >= 1)
+            {
+                printf("False positive rate must be between 0 and 1: %s\n", argv[arg]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[arg], "-T") == 0 && arg + 1 < argc && atoi(argv[arg + 1]) > 0)
+        {
+            threads = atoi(argv[++arg]);
+        }
+        else
+        {
+            printf("Unknown option: %s\n", argv[arg]);
+            return 1;
+        }
+    }
+    argc -= arg - 1;
+    argv += arg - 1;
+
+    // Threads started later inherit the benchmark's CPU, so shards get their own
+    sd_shards(SD_SHARDS, (cpu >= 0) ? cpu + 1 : -1);
+
+    // Every cell of the matrix or the sweep runs in its own child process
+    if ((matrix && (argc == 1 || argc == 3)) || (sweep && (argc == 3 || argc == 4)))
+    {
+        if (cpu >= 0 && !harness_pin(cpu))
+        {
+            printf("Could not pin to cpu %d.\n", cpu);
+            return 1;
+        }
+        ingest_pipeline(pipelined);
+
+        if (sweep)
+        {
+            const char *one[] = {(argc == 4) ? argv[3] : NULL, NULL};
+            structure_ops ops;
+            if (argc == 4 && !select_structure(argv[3], &ops))
+            {
+                printf("Unknown structure: %s\n", argv[3]);
+                return 1;
+            }
+            return matrix_sweep((argc == 4) ? one : structures, argv[1], argv[2], timeout, run_cell);
+        }
+        return matrix_run(structures, (argc == 3) ? argv[1] : "dataset",
+                          (argc == 3) ? argv[2] : "search", timeout, run_cell);
+    }
+
     if (argc != 3 && argc != 4)
     {
-        printf("Usage: ./efficiency dataset/file search/file structure\n");
+        printf("Usage: ./efficiency [-p] [-b] [-B N] [-q MODE] [-e] [-H HASH] [-L LOAD] [-s N] [-r N] [-w N] [-c CPU] [-o FILE] [-F RATE] [-T THREADS] dataset/file search/file structure\n");
+        printf("       ./efficiency -m [-q MODE] [-t SECONDS] [dataset/ search/]\n");
+        printf("       ./efficiency -g [-q MODE] [-t SECONDS] dataset/file search/file [structure]\n");
+        printf("       MODE is fused (search and delete), lookup or delete\n");
         return 1;
     }
 
     // Structures for timing data
     struct rusage before, after;
+    struct timespec start, stop;
 
     // Benchmarks
     double time_load = 0.0, time_check = 0.0, time_unload = 0.0;
@@ -51,128 +403,425 @@ int main(int argc, char *argv[])
 
     // Match structure with appropriate functions
     structure_ops ops;
-    if (strcmp(structure, "sll") == 0)
+    if (!select_structure(structure, &ops))
     {
-        ops.insert = sll_insert;
-        ops.search = sll_search;
-        ops.unload = sll_unload;
+        printf("Unknown structure: %s\n", structure);
+        return 1;
     }
-    else if (strcmp(structure, "dll") == 0)
+
+    // Pin before anything is allocated so memory comes from the CPU's node
+    if (cpu >= 0 && !harness_pin(cpu))
     {
-        ops.insert = dll_insert;
-        ops.search = dll_search;
-        ops.unload = dll_unload;
+        printf("Could not pin to cpu %d.\n", cpu);
+        return 1;
     }
-    else if (strcmp(structure, "bst") == 0)
+
+    ingest_pipeline(pipelined);
+
+    // Threaded searches load a fresh instance for every thread count
+    if (threads > 0)
     {
-        ops.insert = bst_insert;
-        ops.search = bst_search;
-        ops.unload = bst_unload;
+        if (batch > 0 || sample > 0 || events || filter_rate > 0 || repetitions > 0 || warmup >= 0 || output != NULL)
+        {
+            printf("-T can't be combined with -B, -s, -e, -F or the harness options.\n");
+            return 1;
+        }
+        return scaling(&ops, structure, data, (argc == 4) ? argv[2] : argv[1], threads, cpu);
     }
-    else if (strcmp(structure, "avl") == 0)
+
+    // Batches are only fed to single runs, and aren't timed key by key
+    if (batch > 0 && (sample > 0 || repetitions > 0 || warmup >= 0 || output != NULL))
     {
-        ops.insert = avl_insert;
-        ops.search = avl_search;
-        ops.unload = avl_unload;
+        printf("-B can't be combined with -s or the harness options.\n");
+        return 1;
     }
-    else if (strcmp(structure, "h") == 0)
+
+    // Repeated runs go through the harness instead
+    if (repetitions > 0 || warmup >= 0 || output != NULL)
     {
-        ops.insert = hash_insert;
-        ops.search = hash_search;
-        ops.unload = hash_unload;
+        harness_run run;
+        run.structure = structure;
+        run.dataset = data;
+        run.search = (argc == 4) ? argv[2] : argv[1];
+        run.mode = pipelined ? "pipelined" : "serial";
+        run.query = query_modes[query_mode];
+        run.warmup = (warmup >= 0) ? warmup : 1;
+        run.repetitions = (repetitions > 0) ? repetitions : 5;
+        run.cpu = cpu;
+        return harness(&ops, &run, output);
     }
-    else if (strcmp(structure, "t") == 0)
+
+    // Latencies of the operations timed one by one
+    histogram *insert_latency = NULL, *search_latency = NULL;
+    if (sample > 0)
     {
-        ops.insert = trie_insert;
-        ops.search = trie_search;
-        ops.unload = trie_unload;
+        latency_init();
+        insert_latency = malloc(sizeof(histogram));
+        search_latency = malloc(sizeof(histogram));
+        if (insert_latency == NULL || search_latency == NULL)
+        {
+            printf("Could not allocate latency histograms.\n");
+            return 1;
+        }
+        hist_reset(insert_latency);
+        hist_reset(search_latency);
     }
-    else
+
+    // The instance the dataset is loaded into, and what each query does to it
+    query_fn query = select_query(&ops);
+    void *s = ops.create();
+    if (s == NULL)
     {
-        printf("Unknown structure: %s\n", structure);
+        printf("Could not create %s.\n", structure);
         return 1;
     }
 
+    // Batches are fed from memory, so the dataset is read before the timer starts
+    int *keys = NULL;
+    size_t keyCount = 0;
+    if (batch > 0)
+    {
+        keys = reader_load(data, &keyCount);
+        if (keys == NULL)
+        {
+            printf("Could not load %s.\n", data);
+            ops.destroy(s);
+            return 1;
+        }
+
+        // the filter is sized for the keys before they arrive, as a load sizes it from the file
+        if (filter_rate > 0 && !filter_expect(s, keyCount))
+        {
+            printf("Could not allocate the filter.\n");
+            free(keys);
+            ops.destroy(s);
+            return 1;
+        }
+    }
+
+    // Hardware counters, left out if the kernel doesn't allow them
+    counts phase_counts[HARNESS_PHASES];
+    if (events)
+    {
+        events = counters_open();
+    }
+
     // Load database into structure
+    // CPU time adds up both threads when pipelined, so wall time is kept too
+    ingest_sample(sample, insert_latency);
+    clock_gettime(CLOCK_MONOTONIC, &start);
     getrusage(RUSAGE_SELF, &before);
-    bool loaded = ops.insert(data);
+    if (events)
+    {
+        counters_start();
+    }
+    bool loaded = (batch > 0) ? insert_batches(&ops, s, keys, keyCount, batch) : ops.insert(s, data);
+    if (events)
+    {
+        counters_stop(&phase_counts[HARNESS_INSERT]);
+    }
     getrusage(RUSAGE_SELF, &after);
+    clock_gettime(CLOCK_MONOTONIC, &stop);
     printf("Insertion Finished\n");
-
+    free(keys);
 
     // Exit if database not loaded
     if (!loaded)
     {
         printf("Could not load %s.\n", data);
+        ops.destroy(s);
         return 1;
     }
 
     // Calculate time to load database
     time_load = calculate(&before, &after);
+    double wall_load = elapsed(&start, &stop);
+    size_t inserted = (batch > 0) ? keyCount : ingest_count();
+    size_t loaded_bytes = mem_total(ops.memory(s));
 
-    // Try to open dataset
-    char *text = (argc == 4) ? argv[2] : argv[1];
-    FILE *file = fopen(text, "r");
-    if (file == NULL)
+    // a structure loaded from preloaded batches hasn't reported its resizes yet
+    if (batch > 0 && ops.resizes != NULL)
     {
-        printf("Could not open %s.\n", text);
-        sll_unload();
-        return 1;
+        ops.resizes(s, "LOADING");
     }
 
-    int numbers;
+    // Try to open dataset
+    char *text = (argc == 4) ? argv[2] : argv[1];
     int numberCount = 0, notFound = 0;
 
-    // read numbers from dataset one at a time
-    while (fscanf(file, "%i", &numbers) == 1)
+    if (bulk)
+    {
+        // load every query up front so the loop only measures the structure
+        size_t count;
+        int *queries = reader_load(text, &count);
+        if (queries == NULL)
+        {
+            printf("Could not open %s.\n", text);
+            ops.destroy(s);
+            return 1;
+        }
+
+        // results of the batch in flight, on the heap since -B has no upper bound
+        bool *results = NULL;
+        if (batch > 1 && query_mode == QUERY_LOOKUP)
+        {
+            results = malloc(batch * sizeof(bool));
+            if (results == NULL)
+            {
+                printf("Could not allocate a batch of %d results.\n", batch);
+                free(queries);
+                ops.destroy(s);
+                return 1;
+            }
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (events)
+        {
+            counters_start();
+        }
+        if (results != NULL)
+        {
+            for (size_t i = 0; i < count; i += batch)
+            {
+                size_t n = (count - i < (size_t) batch) ? count - i : (size_t) batch;
+                notFound += n - ops.contains_batch(s, queries + i, n, results);
+            }
+        }
+        else
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                bool found = (sample > 0 && i % sample == 0) ? sampled_search(query, s, queries[i], search_latency)
+                                                             : query(s, queries[i]);
+                if (!found)
+                {
+                    notFound++;
+                }
+            }
+        }
+        if (events)
+        {
+            counters_stop(&phase_counts[HARNESS_SEARCH]);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &stop);
+
+        time_check = elapsed(&start, &stop);
+        numberCount = count;
+        free(results);
+        free(queries);
+    }
+    else
     {
-        numberCount++;
-        getrusage(RUSAGE_SELF, &before);
-        bool found = ops.search(numbers);
-        getrusage(RUSAGE_SELF, &after);
-        time_check += calculate(&before, &after);
+        reader file;
+        if (!reader_open(&file, text))
+        {
+            printf("Could not open %s.\n", text);
+            ops.destroy(s);
+            return 1;
+        }
+
+        int numbers;
+
+        // counts the reading and the timer calls as well, -b leaves them out
+        if (events)
+        {
+            counters_start();
+        }
+
+        // read numbers from dataset one at a time
+        while (reader_next(&file, &numbers))
+        {
+            // sampled searches count toward the phase's time like the rest
+            getrusage(RUSAGE_SELF, &before);
+            bool found = (sample > 0 && numberCount % sample == 0) ? sampled_search(query, s, numbers, search_latency)
+                                                                   : query(s, numbers);
+            getrusage(RUSAGE_SELF, &after);
+            time_check += calculate(&before, &after);
+            numberCount++;
+
+            if (!found)
+            {
+                //printf("Number not found: %d\n", numbers);
+                notFound++;
+            }
+        }
 
-        if (!found)
+        if (events)
         {
-            //printf("Number not found: %d\n", numbers);
-            notFound++;
+            counters_stop(&phase_counts[HARNESS_SEARCH]);
         }
+
+        // Close text
+        reader_close(&file);
+    }
+
+    // Report what the searches resized, outside of the timed phases
+    if (ops.resizes != NULL)
+    {
+        ops.resizes(s, "SEARCHING");
     }
 
     // Unload database
     getrusage(RUSAGE_SELF, &before);
-    ops.unload();
+    if (events)
+    {
+        counters_start();
+    }
+    ops.unload(s);
+    if (events)
+    {
+        counters_stop(&phase_counts[HARNESS_UNLOAD]);
+    }
     getrusage(RUSAGE_SELF, &after);
 
     // Calculate time to unload database
     time_unload = calculate(&before, &after);
 
-    // Check whether there was an error
-    if (ferror(file))
-    {
-        fclose(file);
-        printf("Error reading %i.\n", numbers);
-        ops.unload();
-        return 1;
-    }
-
-    // Close text
-    fclose(file);
-
     // Print results
-    printf("\n=== TESTING %s EFFICIENCY ===\n", structure);
+    printf("\n=== TESTING %s EFFICIENCY (%s search) ===\n", structure, query_modes[query_mode]);
     printf("NUMBERS NOT FOUND:   %d\n", notFound);
     printf("NUMBERS CHECKED:     %d\n", numberCount);
     printf("\nTIMES (for %s)\n", structure);
     printf("TIME IN INSERTION:   %.6f seconds\n", time_load);
-    printf("TIME IN SEARCH:      %.6f seconds\n", time_check);
+    printf("TIME IN SEARCH:      %.6f seconds%s\n", time_check, bulk ? " (wall, bulk)" : "");
     printf("TIME IN UNLOAD:      %.6f seconds\n", time_unload);
     printf("TIME IN TOTAL:       %.6f seconds\n\n", time_load + time_check + time_unload);
+    char feed[48];
+    if (batch > 0)
+    {
+        snprintf(feed, sizeof(feed), "preloaded, batches of %d", batch);
+    }
+    else
+    {
+        snprintf(feed, sizeof(feed), "%s", pipelined ? "pipelined" : "serial");
+    }
+    printf("INSERTION (%s): %zu keys in %.6f seconds wall, %.0f keys/s\n\n",
+           feed, inserted, wall_load, wall_load > 0 ? inserted / wall_load : 0.0);
+    print_memory(structure, ops.memory(s), loaded_bytes, inserted);
+    if (filter_rate > 0)
+    {
+        filter_print(s);
+    }
+    if (bulk && numberCount > 0)
+    {
+        printf("SEARCH (bulk%s):       %.1f ns/op over %d searches\n\n",
+               (batch > 1 && query_mode == QUERY_LOOKUP) ? ", batched" : "", time_check * 1e9 / numberCount, numberCount);
+    }
+    if (sample > 0)
+    {
+        printf("LATENCY (for %s, 1 in %d sampled, ns, %s clock)\n", structure, sample, latency_clock());
+        printf("%-8s %9s %9s %9s %9s %9s %9s %9s\n", "PHASE", "SAMPLES", "MIN", "MEAN", "P50", "P99", "P99.9", "MAX");
+        hist_print(insert_latency, "insert");
+        hist_print(search_latency, "search");
+        printf("\n");
+        free(insert_latency);
+        free(search_latency);
+    }
+    if (events)
+    {
+        printf("COUNTERS (for %s, per operation, user space%s)\n", structure,
+               pipelined ? ", building thread only" : "");
+        printf("%-8s %11s %11s %6s %11s %11s %11s %11s\n", "PHASE", "CYCLES", "INSTR", "IPC",
+               "BR-MISS", "L1D-MISS", "LLC-MISS", "DTLB-MISS");
+        counters_print(&phase_counts[HARNESS_INSERT], "insert", inserted);
+        counters_print(&phase_counts[HARNESS_SEARCH], "search", numberCount);
+        counters_print(&phase_counts[HARNESS_UNLOAD], "unload", inserted);
+        printf("\n");
+        counters_close();
+    }
 
-
+    ops.destroy(s);
     return 0;
 }
 
+// Matches a structure code with the appropriate functions
+bool select_structure(const char *name, structure_ops *ops)
+{
+    if (strcmp(name, "sll") == 0)
+    {
+        *ops = sll_ops;
+    }
+    else if (strcmp(name, "dll") == 0)
+    {
+        *ops = dll_ops;
+    }
+    else if (strcmp(name, "bst") == 0)
+    {
+        *ops = bst_ops;
+    }
+    else if (strcmp(name, "avl") == 0)
+    {
+        *ops = avl_ops;
+    }
+    else if (strcmp(name, "h") == 0)
+    {
+        *ops = hash_ops;
+        ops->resizes = hash_op_resizes;
+    }
+    else if (strcmp(name, "t") == 0)
+    {
+        *ops = trie_ops;
+    }
+    else if (strcmp(name, "sd") == 0)
+    {
+        *ops = sd_ops;
+        ops->resizes = sd_op_resizes;
+    }
+    else if (strcmp(name, "lf") == 0)
+    {
+        *ops = lf_ops;
+    }
+    else if (strcmp(name, "sh") == 0)
+    {
+        *ops = sh_ops;
+    }
+    else if (strcmp(name, "ck") == 0)
+    {
+        *ops = ck_ops;
+    }
+    else if (strcmp(name, "sw") == 0)
+    {
+        *ops = sw_ops;
+    }
+    else if (strcmp(name, "rh") == 0)
+    {
+        *ops = rh_ops;
+    }
+    else if (strcmp(name, "oa") == 0)
+    {
+        *ops = oa_ops;
+    }
+    else
+    {
+        return false;
+    }
+
+    // with -F the structure is only reached through its filter
+    if (filter_rate > 0)
+    {
+        filter_inner = *ops;
+        *ops = (structure_ops) {filter_create, filter_destroy, filter_insert, filter_add, filter_add_batch,
+                                filter_search, filter_contains, filter_contains_batch, filter_remove,
+                                filter_unload, filter_memory, (ops->resizes != NULL) ? filter_resizes : NULL};
+    }
+    return true;
+}
+
+// Returns the operation the search phase runs for every query
+query_fn select_query(const structure_ops *ops)
+{
+    switch (query_mode)
+    {
+        case QUERY_LOOKUP:
+            return ops->contains;
+        case QUERY_DELETE:
+            return ops->remove;
+        default:
+            return ops->search;
+    }
+}
+
 // Returns number of seconds between b and a
 double calculate(const struct rusage *b, const struct rusage *a)
 {
@@ -189,3 +838,603 @@ double calculate(const struct rusage *b, const struct rusage *a)
                 / 1000000.0);
     }
 }
+
+// Returns number of wall clock seconds between b and a
+double elapsed(const struct timespec *b, const struct timespec *a)
+{
+    return (a->tv_sec - b->tv_sec) + (a->tv_nsec - b->tv_nsec) / 1000000000.0;
+}
+
+// Runs one search timed on its own, adding its latency to h
+bool sampled_search(query_fn query, void *s, int number, histogram *h)
+{
+    uint64_t start = latency_ticks();
+    bool found = query(s, number);
+    hist_record(h, latency_ticks() - start);
+    return found;
+}
+
+// Inserts count preloaded keys into s, batch at a time, or one by one if batch is 1
+bool insert_batches(structure_ops *ops, void *s, const int *keys, size_t count, int batch)
+{
+    if (batch == 1)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            if (!ops->add(s, keys[i]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    for (size_t i = 0; i < count; i += batch)
+    {
+        size_t n = (count - i < (size_t) batch) ? count - i : (size_t) batch;
+        if (!ops->add_batch(s, keys + i, n))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Runs warmup + repetitions full passes with preloaded queries, timing each
+// phase in wall clock seconds, then reports and optionally saves the summary
+int harness(structure_ops *ops, harness_run *run, const char *output)
+{
+    size_t count;
+    int *queries = reader_load(run->search, &count);
+    if (queries == NULL)
+    {
+        printf("Could not open %s.\n", run->search);
+        return 1;
+    }
+
+    // every pass reuses the same instance
+    void *s = ops->create();
+    if (s == NULL)
+    {
+        printf("Could not create %s.\n", run->structure);
+        free(queries);
+        return 1;
+    }
+
+    int status = 0;
+    for (int phase = 0; phase < HARNESS_PHASES; phase++)
+    {
+        run->samples[phase] = calloc(run->repetitions, sizeof(double));
+        if (run->samples[phase] == NULL)
+        {
+            status = 1;
+        }
+    }
+    if (status != 0)
+    {
+        printf("Could not allocate %d repetitions.\n", run->repetitions);
+    }
+
+    for (int i = -run->warmup; i < run->repetitions && status == 0; i++)
+    {
+        double phases[HARNESS_PHASES];
+        size_t notFound;
+        size_t bytes;
+        if (!run_pass(ops, s, run->dataset, queries, count, phases, &notFound, &bytes))
+        {
+            printf("Could not load %s.\n", run->dataset);
+            status = 1;
+            break;
+        }
+
+        // warmup passes only bring caches and the allocator to a steady state
+        for (int phase = 0; i >= 0 && phase < HARNESS_PHASES; phase++)
+        {
+            run->samples[phase][i] = phases[phase];
+        }
+        run->keys = ingest_count();
+        run->queries = count;
+        run->notFound = notFound;
+        run->bytes = bytes;
+        run->peak = ops->memory(s)->peak;
+    }
+
+    if (status == 0)
+    {
+        harness_print(run);
+        if (output != NULL && !harness_write(output, run))
+        {
+            printf("Could not write %s.\n", output);
+            status = 1;
+        }
+    }
+
+    for (int phase = 0; phase < HARNESS_PHASES; phase++)
+    {
+        free(run->samples[phase]);
+    }
+    ops->destroy(s);
+    free(queries);
+    return status;
+}
+
+// Runs one insert/search/unload pass of instance s over preloaded queries, timing
+// each phase in wall clock seconds, returning false if the dataset didn't load
+// If bytes isn't NULL it receives the memory the loaded structure holds
+bool run_pass(structure_ops *ops, void *s, const char *data_file, const int *queries, size_t count,
+              double phases[HARNESS_PHASES], size_t *notFound, size_t *bytes)
+{
+    struct timespec t0, t1;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    bool loaded = ops->insert(s, data_file);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    if (!loaded)
+    {
+        return false;
+    }
+    phases[HARNESS_INSERT] = elapsed(&t0, &t1);
+
+    if (bytes != NULL)
+    {
+        *bytes = mem_total(ops->memory(s));
+    }
+
+    query_fn query = select_query(ops);
+    *notFound = 0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!query(s, queries[i]))
+        {
+            (*notFound)++;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    phases[HARNESS_SEARCH] = elapsed(&t0, &t1);
+    if (ops->resizes != NULL)
+    {
+        ops->resizes(s, "SEARCHING");
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    ops->unload(s);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    phases[HARNESS_UNLOAD] = elapsed(&t0, &t1);
+    return true;
+}
+
+// Runs one matrix or sweep cell, inside the child process forked for it
+bool run_cell(const char *structure, const char *data_file, const char *search_file, size_t limit, cell *c)
+{
+    structure_ops ops;
+    if (!select_structure(structure, &ops))
+    {
+        return false;
+    }
+
+    size_t count;
+    int *queries = reader_load(search_file, &count);
+    void *s = ops.create();
+    if (queries == NULL || s == NULL)
+    {
+        free(queries);
+        ops.destroy(s);
+        return false;
+    }
+
+    // a prefix of the dataset is searched with a prefix of the queries
+    ingest_limit(limit);
+    if (limit > 0 && count > limit)
+    {
+        count = limit;
+    }
+
+    bool done = run_pass(&ops, s, data_file, queries, count, c->phases, &c->notFound, &c->bytes);
+    c->keys = ingest_count();
+    c->queries = count;
+    ops.destroy(s);
+    free(queries);
+    return done;
+}
+
+// Prints what the structure allocated; anything still live after the unload is a leak
+void print_memory(const char *structure, const memstats *m, size_t loaded, size_t keys)
+{
+    printf("MEMORY (for %s)\n", structure);
+    printf("STATIC:              %.2f MB\n", m->fixed / 1048576.0);
+    printf("AFTER INSERTION:     %.2f MB (%.1f bytes/key)\n", loaded / 1048576.0,
+           keys > 0 ? (double) loaded / keys : 0.0);
+    printf("PEAK:                %.2f MB\n", m->peak / 1048576.0);
+    printf("ALLOCATIONS:         %zu (%zu freed)\n", m->allocations, m->frees);
+    printf("LEAKED:              %zu bytes\n\n", m->live);
+}
+
+// Loads a fresh instance for 1, 2, 4 ... threads threads, splits the
+// preloaded queries evenly between them and times them from a common start
+// to the last one finishing, printing the throughput and speedup of each
+// The sharded table is loaded with one shard per thread instead, and the
+// calling thread times routing all the queries to the shards
+int scaling(structure_ops *ops, const char *structure, const char *data, const char *search, int threads, int cpu)
+{
+    bool sharded = strcmp(structure, "sd") == 0;
+    bool safe = sharded;
+    for (int i = 0; concurrent[i] != NULL; i++)
+    {
+        safe = safe || strcmp(structure, concurrent[i]) == 0;
+    }
+    if (!safe)
+    {
+        printf("%s can't be searched from several threads, only sh, lf and sd can.\n", structure);
+        return 1;
+    }
+    int most = sharded ? SD_MAX_SHARDS : LF_THREADS;
+    if (threads > most)
+    {
+        printf("At most %d threads.\n", most);
+        return 1;
+    }
+
+    size_t count;
+    int *queries = reader_load(search, &count);
+    worker *workers = calloc(threads, sizeof(worker));
+    if (queries == NULL || workers == NULL)
+    {
+        printf("Could not open %s.\n", search);
+        free(queries);
+        free(workers);
+        return 1;
+    }
+
+    printf("\n=== SCALING %s (%s search, %zu queries) ===\n", structure, query_modes[query_mode], count);
+    printf("%-8s %12s %12s %9s %11s %10s\n", "THREADS", "SECONDS", "MOPS/S", "SPEEDUP", "EFFICIENCY", "NOT FOUND");
+    query_fn query = select_query(ops);
+    size_t (*route)(sdtable *t, const int *keys, size_t n, bool *found) = sd_search_batch;
+    if (query_mode == QUERY_LOOKUP)
+    {
+        route = sd_contains_batch;
+    }
+    else if (query_mode == QUERY_DELETE)
+    {
+        route = sd_remove_batch;
+    }
+    double single = 0;
+    int status = 0;
+    for (int n = 1; n <= threads && status == 0; n = (n < threads && n * 2 > threads) ? threads : n * 2)
+    {
+        if (sharded)
+        {
+            sd_shards(n, (cpu >= 0) ? cpu + 1 : -1);
+        }
+        void *s = ops->create();
+        if (s == NULL || !ops->insert(s, data))
+        {
+            printf("Could not load %s.\n", data);
+            ops->destroy(s);
+            status = 1;
+            break;
+        }
+
+        struct timespec t0, t1;
+        size_t notFound = 0;
+        int started = n;
+        if (sharded)
+        {
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+            notFound = count - route(s, queries, count, NULL);
+            clock_gettime(CLOCK_MONOTONIC, &t1);
+        }
+        else
+        {
+            // the threads wait on the gate, so none starts before the clock
+            pthread_rwlock_t gate;
+            pthread_rwlock_init(&gate, NULL);
+            pthread_rwlock_wrlock(&gate);
+            for (started = 0; started < n; started++)
+            {
+                worker *w = &workers[started];
+                w->query = query;
+                w->s = s;
+                w->queries = queries + count * started / n;
+                w->count = count * (started + 1) / n - count * started / n;
+                w->notFound = 0;
+                w->cpu = (cpu >= 0) ? cpu + started : -1;
+                w->gate = &gate;
+                if (pthread_create(&w->thread, NULL, scaling_worker, w) != 0)
+                {
+                    break;
+                }
+            }
+
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+            pthread_rwlock_unlock(&gate);
+            for (int i = 0; i < started; i++)
+            {
+                pthread_join(workers[i].thread, NULL);
+                notFound += workers[i].notFound;
+            }
+            clock_gettime(CLOCK_MONOTONIC, &t1);
+            pthread_rwlock_destroy(&gate);
+        }
+        ops->destroy(s);
+
+        if (started < n)
+        {
+            printf("Could not start %d threads.\n", n);
+            status = 1;
+            break;
+        }
+        double seconds = elapsed(&t0, &t1);
+        single = (n == 1) ? seconds : single;
+        printf("%-8d %12.6f %12.2f %9.2f %10.0f%% %10zu\n", n, seconds, count / seconds / 1e6, single / seconds,
+               100 * single / seconds / n, notFound);
+    }
+    printf("\n");
+
+    free(workers);
+    free(queries);
+    return status;
+}
+
+// Runs one thread's share of the queries once the gate opens
+void *scaling_worker(void *arg)
+{
+    worker *w = arg;
+    if (w->cpu >= 0 && !harness_pin(w->cpu))
+    {
+        printf("Could not pin to cpu %d.\n", w->cpu);
+    }
+    pthread_rwlock_rdlock(w->gate);
+    pthread_rwlock_unlock(w->gate);
+
+    // counted locally, so the threads don't share a cache line while they run
+    size_t notFound = 0;
+    for (size_t i = 0; i < w->count; i++)
+    {
+        notFound += !w->query(w->s, w->queries[i]);
+    }
+    w->notFound = notFound;
+    return NULL;
+}
+
+// Creates the structure behind a filter; the filter itself comes with the first load
+void *filter_create(void)
+{
+    filtered *f = calloc(1, sizeof(filtered));
+    if (f == NULL)
+    {
+        return NULL;
+    }
+    f->s = filter_inner.create();
+    if (f->s == NULL)
+    {
+        free(f);
+        return NULL;
+    }
+    return f;
+}
+
+// Frees the structure, its filter and the room kept for batches
+void filter_destroy(void *s)
+{
+    filtered *f = s;
+    if (f != NULL)
+    {
+        filter_inner.destroy(f->s);
+        bloom_destroy(f->filter, &f->mem);
+        free(f->keys);
+        free(f->where);
+        free(f->found);
+        free(f);
+    }
+}
+
+// Sizes a new filter for the keys of the file, then loads the structure,
+// which hands every key to the filter on its way in
+bool filter_insert(void *s, const char *filename)
+{
+    filtered *f = s;
+    if (!filter_expect(f, ingest_expected(filename)))
+    {
+        return false;
+    }
+    ingest_tap(filter_tap, f);
+    bool loaded = filter_inner.insert(f->s, filename);
+    ingest_tap(NULL, NULL);
+    return loaded;
+}
+
+// Adds a number to the filter and the structure
+// Without a filter sized by a load or filter_expect, the one created here fills up fast, but never turns a number away wrongly
+bool filter_add(void *s, int number)
+{
+    filtered *f = s;
+    if (f->filter == NULL && !filter_expect(f, 0))
+    {
+        return false;
+    }
+    bloom_add(f->filter, number);
+    return filter_inner.add(f->s, number);
+}
+
+// Adds n numbers to the filter and the structure
+bool filter_add_batch(void *s, const int *keys, size_t n)
+{
+    filtered *f = s;
+    if (f->filter == NULL && !filter_expect(f, 0))
+    {
+        return false;
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        bloom_add(f->filter, keys[i]);
+    }
+    return filter_inner.add_batch(f->s, keys, n);
+}
+
+// The three kinds of query, each behind the filter
+bool filter_search(void *s, int number)
+{
+    return filter_query(s, filter_inner.search, number);
+}
+
+bool filter_contains(void *s, int number)
+{
+    return filter_query(s, filter_inner.contains, number);
+}
+
+bool filter_remove(void *s, int number)
+{
+    return filter_query(s, filter_inner.remove, number);
+}
+
+// Looks up n numbers, sending only the ones that get past the filter on
+// to the structure, as one batch
+size_t filter_contains_batch(void *s, const int *keys, size_t n, bool *found)
+{
+    filtered *f = s;
+    size_t hits = 0;
+    if (f->filter == NULL || (n > f->room && !filter_room(f, n)))
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            found[i] = filter_query(f, filter_inner.contains, keys[i]);
+            hits += found[i];
+        }
+        return hits;
+    }
+
+    size_t passed = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        if (i + FILTER_PREFETCH < n)
+        {
+            bloom_prefetch(f->filter, keys[i + FILTER_PREFETCH]);
+        }
+        found[i] = false;
+        if (bloom_contains(f->filter, keys[i]))
+        {
+            f->keys[passed] = keys[i];
+            f->where[passed++] = i;
+        }
+    }
+    if (passed > 0)
+    {
+        hits = filter_inner.contains_batch(f->s, f->keys, passed, f->found);
+    }
+    for (size_t i = 0; i < passed; i++)
+    {
+        found[f->where[i]] = f->found[i];
+    }
+
+    f->queries += n;
+    f->rejected += n - passed;
+    f->wasted += passed - hits;
+    return hits;
+}
+
+// Empties the structure and frees the filter; its counts stay for the report
+void filter_unload(void *s)
+{
+    filtered *f = s;
+    filter_inner.unload(f->s);
+    bloom_destroy(f->filter, &f->mem);
+    f->filter = NULL;
+}
+
+// Returns the allocation counters of the structure, with the filter's bits added
+memstats *filter_memory(void *s)
+{
+    filtered *f = s;
+    f->total = *filter_inner.memory(f->s);
+    f->total.live += f->mem.live;
+    f->total.peak += f->mem.peak;
+    f->total.allocations += f->mem.allocations;
+    f->total.frees += f->mem.frees;
+    return &f->total;
+}
+
+// Prints the resizes of the structure behind the filter
+void filter_resizes(void *s, const char *phase)
+{
+    filtered *f = s;
+    filter_inner.resizes(f->s, phase);
+}
+
+// Replaces the filter with an empty one sized for keys numbers, and clears
+// its counts, returning false if out of memory
+bool filter_expect(void *s, size_t keys)
+{
+    filtered *f = s;
+    bloom_destroy(f->filter, &f->mem);
+    mem_reset(&f->mem);
+    f->filter = bloom_create(keys, filter_rate, &f->mem);
+    if (f->filter == NULL)
+    {
+        return false;
+    }
+
+    f->expected = keys;
+    f->bytes = bloom_bytes(f->filter);
+    f->bits = bloom_bits(f->filter);
+    f->hashes = bloom_hashes(f->filter);
+    f->rate = bloom_rate(f->filter);
+    f->queries = 0;
+    f->rejected = 0;
+    f->wasted = 0;
+    return true;
+}
+
+// Adds a key on its way from ingest into the structure to the filter
+void filter_tap(void *s, int number)
+{
+    filtered *f = s;
+    bloom_add(f->filter, number);
+}
+
+// Runs query on the structure unless the filter rules number out
+bool filter_query(filtered *f, query_fn query, int number)
+{
+    f->queries++;
+    if (f->filter != NULL && !bloom_contains(f->filter, number))
+    {
+        f->rejected++;
+        return false;
+    }
+    bool found = query(f->s, number);
+    f->wasted += !found;
+    return found;
+}
+
+// Grows the room for the keys of a batch that get past the filter to n,
+// returning false if out of memory
+bool filter_room(filtered *f, size_t n)
+{
+    int *keys = realloc(f->keys, n * sizeof(int));
+    f->keys = (keys != NULL) ? keys : f->keys;
+    size_t *where = realloc(f->where, n * sizeof(size_t));
+    f->where = (where != NULL) ? where : f->where;
+    bool *found = realloc(f->found, n * sizeof(bool));
+    f->found = (found != NULL) ? found : f->found;
+    if (keys == NULL || where == NULL || found == NULL)
+    {
+        return false;
+    }
+    f->room = n;
+    return true;
+}
+
+// Prints how the filter was sized and how many queries it kept from the structure
+void filter_print(void *s)
+{
+    filtered *f = s;
+    size_t passed = f->queries - f->rejected;
+    size_t absent = f->rejected + f->wasted;
+    printf("FILTER (blocked Bloom, %.3g%% false positives asked)\n", filter_rate * 100);
+    printf("SIZE:                %.2f MB for %zu keys (%.2f bits/key, %d hashes, %.3g%% predicted)\n",
+           f->bytes / 1048576.0, f->expected, f->bits, f->hashes, f->rate * 100);
+    printf("RULED OUT:           %zu of %zu queries (%.1f%%), each a structure probe saved\n", f->rejected,
+           f->queries, f->queries > 0 ? 100.0 * f->rejected / f->queries : 0.0);
+    printf("LET THROUGH:         %zu, %zu of them not there (%.3g%% of the absent queries)\n\n", passed,
+           f->wasted, absent > 0 ? 100.0 * f->wasted / absent : 0.0);
+}
@@ -0,0 +1,237 @@
+// Statistics and reporting for repeated benchmark runs
+
+// Every phase is summarised by its median, its median absolute deviation
+// and a distribution-free 95% confidence interval for the median taken from
+// the order statistics, which hold up far better than mean and standard
+// deviation against the odd run disturbed by the rest of the system
+
+// Results can be written as JSON (one document per run) or appended to a
+// CSV file (one row per phase) to be tracked across builds
+
+#define _GNU_SOURCE
+
+#include <math.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "harness.h"
+
+// Function prototypes
+int compare_doubles(const void *a, const void *b);
+double median_sorted(const double *sorted, int n);
+size_t phase_ops(const harness_run *run, int phase);
+bool write_json(FILE *out, const harness_run *run);
+void write_string(FILE *out, const char *name, const char *value);
+bool write_csv(FILE *out, const harness_run *run, bool header);
+
+// Names of the phases in reports
+const char *harness_phases[HARNESS_PHASES] = {"insert", "search", "unload"};
+
+// Pins the calling thread, and every thread it starts later, to one CPU
+bool harness_pin(int cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+// Computes median, MAD and a 95% confidence interval for the median
+void harness_summarize(const double *samples, int n, summary *s)
+{
+    memset(s, 0, sizeof(summary));
+    if (n <= 0)
+    {
+        return;
+    }
+
+    double *sorted = malloc(n * sizeof(double));
+    double *deviations = malloc(n * sizeof(double));
+    if (sorted == NULL || deviations == NULL)
+    {
+        free(sorted);
+        free(deviations);
+        return;
+    }
+
+    memcpy(sorted, samples, n * sizeof(double));
+    qsort(sorted, n, sizeof(double), compare_doubles);
+    s->median = median_sorted(sorted, n);
+    s->min = sorted[0];
+    s->max = sorted[n - 1];
+
+    for (int i = 0; i < n; i++)
+    {
+        deviations[i] = fabs(sorted[i] - s->median);
+    }
+    qsort(deviations, n, sizeof(double), compare_doubles);
+    s->mad = median_sorted(deviations, n);
+
+    // the order statistics of (1-based) ranks n/2 - 1.96 * sqrt(n)/2 and
+    // 1 + n/2 + 1.96 * sqrt(n)/2 bracket the median 95% of the time
+    // (normal approximation of the binomial, clamped for small n)
+    int low = (int) floor(n / 2.0 - 1.96 * sqrt(n) / 2.0);
+    int high = (int) ceil(1 + n / 2.0 + 1.96 * sqrt(n) / 2.0);
+    s->ci_low = sorted[low < 1 ? 0 : low - 1];
+    s->ci_high = sorted[high > n ? n - 1 : high - 1];
+
+    free(sorted);
+    free(deviations);
+}
+
+// Prints the summary table for a run
+void harness_print(const harness_run *run)
+{
+    printf("\n=== HARNESS %s (%s queries, %d warmup, %d repetitions", run->structure, run->query,
+           run->warmup, run->repetitions);
+    if (run->cpu >= 0)
+    {
+        printf(", pinned to cpu %d", run->cpu);
+    }
+    printf(") ===\n");
+    printf("%-8s %12s %12s %12s %12s %12s\n", "PHASE", "MEDIAN s", "MAD s", "CI95 LOW", "CI95 HIGH", "ns/op");
+
+    for (int phase = 0; phase < HARNESS_PHASES; phase++)
+    {
+        summary s;
+        harness_summarize(run->samples[phase], run->repetitions, &s);
+        size_t ops = phase_ops(run, phase);
+        printf("%-8s %12.6f %12.6f %12.6f %12.6f %12.1f\n", harness_phases[phase],
+               s.median, s.mad, s.ci_low, s.ci_high, ops > 0 ? s.median * 1e9 / ops : 0.0);
+    }
+    printf("MEMORY: %.2f MB after insertion (%.1f bytes/key), %.2f MB peak\n\n", run->bytes / 1048576.0,
+           run->keys > 0 ? (double) run->bytes / run->keys : 0.0, run->peak / 1048576.0);
+}
+
+// Writes a run to filename: appended as CSV rows if it ends in .csv, else as JSON
+bool harness_write(const char *filename, const harness_run *run)
+{
+    size_t length = strlen(filename);
+    bool csv = length >= 4 && strcmp(filename + length - 4, ".csv") == 0;
+
+    FILE *out = fopen(filename, csv ? "a" : "w");
+    if (out == NULL)
+    {
+        return false;
+    }
+
+    // only a new CSV file needs the header row
+    bool written = csv ? write_csv(out, run, ftell(out) == 0) : write_json(out, run);
+    return fclose(out) == 0 && written;
+}
+
+// Comparison function for qsort
+int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+// Returns the median of an already sorted array
+double median_sorted(const double *sorted, int n)
+{
+    if (n % 2 == 1)
+    {
+        return sorted[n / 2];
+    }
+    return (sorted[n / 2 - 1] + sorted[n / 2]) / 2.0;
+}
+
+// Returns how many operations a phase performs, for ns/op
+size_t phase_ops(const harness_run *run, int phase)
+{
+    return (phase == HARNESS_SEARCH) ? run->queries : run->keys;
+}
+
+bool write_json(FILE *out, const harness_run *run)
+{
+    fprintf(out, "{\n");
+    write_string(out, "structure", run->structure);
+    write_string(out, "dataset", run->dataset);
+    write_string(out, "search", run->search);
+    write_string(out, "mode", run->mode);
+    write_string(out, "query", run->query);
+    fprintf(out, "  \"warmup\": %d,\n", run->warmup);
+    fprintf(out, "  \"repetitions\": %d,\n", run->repetitions);
+    fprintf(out, "  \"cpu\": %d,\n", run->cpu);
+    fprintf(out, "  \"keys\": %zu,\n", run->keys);
+    fprintf(out, "  \"queries\": %zu,\n", run->queries);
+    fprintf(out, "  \"not_found\": %zu,\n", run->notFound);
+    fprintf(out, "  \"bytes\": %zu,\n", run->bytes);
+    fprintf(out, "  \"peak_bytes\": %zu,\n", run->peak);
+    fprintf(out, "  \"bytes_per_key\": %.3f,\n", run->keys > 0 ? (double) run->bytes / run->keys : 0.0);
+    fprintf(out, "  \"phases\": {\n");
+
+    for (int phase = 0; phase < HARNESS_PHASES; phase++)
+    {
+        summary s;
+        harness_summarize(run->samples[phase], run->repetitions, &s);
+        size_t ops = phase_ops(run, phase);
+
+        fprintf(out, "    \"%s\": {\n", harness_phases[phase]);
+        fprintf(out, "      \"median_s\": %.9f,\n", s.median);
+        fprintf(out, "      \"mad_s\": %.9f,\n", s.mad);
+        fprintf(out, "      \"ci95_low_s\": %.9f,\n", s.ci_low);
+        fprintf(out, "      \"ci95_high_s\": %.9f,\n", s.ci_high);
+        fprintf(out, "      \"min_s\": %.9f,\n", s.min);
+        fprintf(out, "      \"max_s\": %.9f,\n", s.max);
+        fprintf(out, "      \"ns_per_op\": %.3f,\n", ops > 0 ? s.median * 1e9 / ops : 0.0);
+        fprintf(out, "      \"samples_s\": [");
+        for (int i = 0; i < run->repetitions; i++)
+        {
+            fprintf(out, "%s%.9f", i > 0 ? ", " : "", run->samples[phase][i]);
+        }
+        fprintf(out, "]\n    }%s\n", phase < HARNESS_PHASES - 1 ? "," : "");
+    }
+
+    fprintf(out, "  }\n}\n");
+    return !ferror(out);
+}
+
+// Writes one "name": "value" line of the JSON document, escaping the value
+// (file names can hold quotes, backslashes or control characters)
+void write_string(FILE *out, const char *name, const char *value)
+{
+    fprintf(out, "  \"%s\": \"", name);
+    for (const unsigned char *c = (const unsigned char *) value; *c != '\0'; c++)
+    {
+        if (*c == '"' || *c == '\\')
+        {
+            fprintf(out, "\\%c", *c);
+        }
+        else if (*c < 0x20)
+        {
+            fprintf(out, "\\u%04x", *c);
+        }
+        else
+        {
+            fputc(*c, out);
+        }
+    }
+    fprintf(out, "\",\n");
+}
+
+bool write_csv(FILE *out, const harness_run *run, bool header)
+{
+    if (header)
+    {
+        fprintf(out, "structure,dataset,search,mode,query,phase,warmup,repetitions,cpu,ops,"
+                     "median_s,mad_s,ci95_low_s,ci95_high_s,min_s,max_s,ns_per_op,bytes,peak_bytes\n");
+    }
+
+    for (int phase = 0; phase < HARNESS_PHASES; phase++)
+    {
+        summary s;
+        harness_summarize(run->samples[phase], run->repetitions, &s);
+        size_t ops = phase_ops(run, phase);
+
+        fprintf(out, "%s,%s,%s,%s,%s,%s,%d,%d,%d,%zu,%.9f,%.9f,%.9f,%.9f,%.9f,%.9f,%.3f,%zu,%zu\n",
+                run->structure, run->dataset, run->search, run->mode, run->query, harness_phases[phase],
+                run->warmup, run->repetitions, run->cpu, ops, s.median, s.mad,
+                s.ci_low, s.ci_high, s.min, s.max, ops > 0 ? s.median * 1e9 / ops : 0.0,
+                run->bytes, run->peak);
+    }
+    return !ferror(out);
+}
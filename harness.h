@@ -0,0 +1,48 @@
+#ifndef HARNESS_H
+#define HARNESS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Phases timed on every repetition
+#define HARNESS_INSERT 0
+#define HARNESS_SEARCH 1
+#define HARNESS_UNLOAD 2
+#define HARNESS_PHASES 3
+
+// Robust summary of the timings of one phase, in seconds
+typedef struct summary
+{
+    double median;
+    double mad;
+    double ci_low;
+    double ci_high;
+    double min;
+    double max;
+} summary;
+
+// Everything recorded by a harness run
+typedef struct harness_run
+{
+    const char *structure;
+    const char *dataset;
+    const char *search;
+    const char *mode;
+    const char *query;
+    int warmup;
+    int repetitions;
+    int cpu;
+    size_t keys;
+    size_t queries;
+    size_t notFound;
+    size_t bytes;
+    size_t peak;
+    double *samples[HARNESS_PHASES];
+} harness_run;
+
+bool harness_pin(int cpu);
+void harness_summarize(const double *samples, int n, summary *s);
+void harness_print(const harness_run *run);
+bool harness_write(const char *filename, const harness_run *run);
+
+#endif
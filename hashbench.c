@@ -0,0 +1,163 @@
+// Quality and speed benchmark for the hash functions in hashfunc.c
+// Hashes every key of each dataset into a power of two table the size of
+// the dataset and reports, for every function this CPU supports:
+//   cycles/hash  time per hash, in TSC cycles where the TSC is invariant
+//   ns/hash      time per hash, in nanoseconds
+//   chi2/df      chi-square of the bucket loads against a uniform spread,
+//                per degree of freedom: close to 1 is as good as random,
+//                well below 1 is more even than random, above is worse
+//   max load     the longest chain the table would get
+//   collisions   keys landing in an already used bucket, next to what a
+//                uniformly random hash would give on average
+// Usage ./hashbench [dataset/file.txt ...]
+//   without files, runs on the random, sorted and reversed datasets
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "hashfunc.h"
+#include "latency.h"
+#include "reader.h"
+
+// Every function is timed this many times over the keys and the best run is kept
+#define REPETITIONS 5
+
+// Function prototypes
+double now(void);
+void run(const char *filename);
+void report(int kind, const int *keys, size_t count, uint32_t *loads, size_t buckets);
+
+// Global variables
+// the hashes are xored into it, which keeps the compiler from dropping them
+volatile uint32_t sink;
+
+int main(int argc, char *argv[])
+{
+    latency_init();
+
+    if (argc == 1)
+    {
+        const char *arrangements[] = {"dataset/random.txt", "dataset/sorted.txt", "dataset/reversed.txt"};
+        for (int i = 0; i < 3; i++)
+        {
+            run(arrangements[i]);
+        }
+    }
+    for (int i = 1; i < argc; i++)
+    {
+        run(argv[i]);
+    }
+    printf("\n");
+    return 0;
+}
+
+// Returns a monotonic timestamp in seconds
+double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Benchmarks every hash function on one dataset
+void run(const char *filename)
+{
+    size_t count;
+    int *keys = reader_load(filename, &count);
+    if (keys == NULL || count == 0)
+    {
+        printf("Could not read %s.\n", filename);
+        free(keys);
+        return;
+    }
+
+    // the smallest power of two table with no more keys than buckets
+    size_t buckets = 1;
+    while (buckets < count)
+    {
+        buckets *= 2;
+    }
+    uint32_t *loads = malloc(buckets * sizeof(uint32_t));
+    if (loads == NULL)
+    {
+        printf("Could not allocate %zu buckets.\n", buckets);
+        free(keys);
+        return;
+    }
+
+    // collisions a uniformly random hash would cause on average
+    double expected = count - buckets * (1 - pow(1 - 1.0 / buckets, count));
+
+    printf("\n=== HASHING %s (%zu keys, %zu buckets) ===\n", filename, count, buckets);
+    printf("%-10s %12s %10s %10s %9s %12s (uniform %.0f)\n", "hash", "cycles/hash", "ns/hash", "chi2/df",
+           "max load", "collisions", expected);
+    for (int kind = 0; kind < HASHFN_COUNT; kind++)
+    {
+        if (hashfn_get(kind) != NULL)
+        {
+            report(kind, keys, count, loads, buckets);
+        }
+    }
+
+    free(loads);
+    free(keys);
+}
+
+// Times one hash function over the keys and prints how evenly it spreads them
+void report(int kind, const int *keys, size_t count, uint32_t *loads, size_t buckets)
+{
+    hash_fn fn = hashfn_get(kind);
+
+    uint64_t best = 0;
+    double bestSeconds = 0;
+    uint32_t checksum = 0;
+    for (int rep = 0; rep < REPETITIONS; rep++)
+    {
+        double start = now();
+        uint64_t ticks = latency_ticks();
+        for (size_t i = 0; i < count; i++)
+        {
+            checksum ^= fn(keys[i]);
+        }
+        ticks = latency_ticks() - ticks;
+        double seconds = now() - start;
+        if (rep == 0 || ticks < best)
+        {
+            best = ticks;
+            bestSeconds = seconds;
+        }
+    }
+    sink = checksum;
+
+    // bucket the keys the way the hash table does: the top bits of the hash
+    memset(loads, 0, buckets * sizeof(uint32_t));
+    for (size_t i = 0; i < count; i++)
+    {
+        loads[((uint64_t) fn(keys[i]) * buckets) >> 32]++;
+    }
+
+    double mean = (double) count / buckets;
+    double chi = 0;
+    uint32_t maximum = 0;
+    size_t used = 0;
+    for (size_t b = 0; b < buckets; b++)
+    {
+        chi += (loads[b] - mean) * (loads[b] - mean) / mean;
+        maximum = (loads[b] > maximum) ? loads[b] : maximum;
+        used += (loads[b] > 0);
+    }
+
+    // without an invariant TSC the ticks are nanoseconds, not cycles
+    char cycles[32] = "-";
+    if (strcmp(latency_clock(), "tsc") == 0)
+    {
+        snprintf(cycles, sizeof(cycles), "%.2f", (double) best / count);
+    }
+    printf("%-10s %12s %10.2f %10.3f %9u %12zu\n", hashfn_name(kind), cycles, bestSeconds * 1e9 / count,
+           (buckets > 1) ? chi / (buckets - 1) : 0.0, maximum, count - used);
+}
@@ -0,0 +1,138 @@
+// Hash functions for integer keys
+
+// Every function returns 32 bits whose top bits are well mixed, so a
+// table of any size takes its bucket as (hash * size) >> 32, which on a
+// power of two table is just the top bits and costs no division:
+//   fibonacci  multiply by 2^32 / Phi (golden number), one instruction,
+//              but sequential keys come out evenly spaced rather than random
+//   murmur3    the 32-bit finalizer of MurmurHash3, two multiplies and
+//              three xor-shifts, every input bit affects every output bit
+//   xxh3       the 4 byte path of XXH3 (rrmxmx) over the key and a fixed
+//              secret, with 64-bit arithmetic
+//   crc32c     the SSE4.2 crc32 instruction, only where the CPU has it
+
+// The table uses fibonacci unless another one is selected
+
+#include <string.h>
+
+#include "hashfunc.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HASHFN_X86
+#endif
+
+// Function prototypes
+uint32_t hash_fibonacci(int number);
+uint32_t hash_murmur3(int number);
+uint32_t hash_xxh3(int number);
+#ifdef HASHFN_X86
+uint32_t hash_crc32c(int number);
+#endif
+
+// Global variables
+hash_fn hash_active = hash_fibonacci;
+
+// Names of the hash functions, by kind
+const char *hashfn_names[HASHFN_COUNT] = {"fibonacci", "murmur3", "xxh3", "crc32c"};
+
+// Picks the hash function the hash table uses, returning false if the CPU can't run it
+bool hashfn_select(int kind)
+{
+    hash_fn fn = hashfn_get(kind);
+    if (fn == NULL)
+    {
+        return false;
+    }
+    hash_active = fn;
+    return true;
+}
+
+// Returns the kind of the hash function called name, or -1 if there is none
+int hashfn_find(const char *name)
+{
+    for (int kind = 0; kind < HASHFN_COUNT; kind++)
+    {
+        if (strcmp(name, hashfn_names[kind]) == 0)
+        {
+            return kind;
+        }
+    }
+    return -1;
+}
+
+// Returns the name of a hash function
+const char *hashfn_name(int kind)
+{
+    return (kind >= 0 && kind < HASHFN_COUNT) ? hashfn_names[kind] : "unknown";
+}
+
+// Returns a hash function, or NULL if it doesn't exist or the CPU can't run it
+hash_fn hashfn_get(int kind)
+{
+    switch (kind)
+    {
+        case HASHFN_FIBONACCI:
+            return hash_fibonacci;
+        case HASHFN_MURMUR3:
+            return hash_murmur3;
+        case HASHFN_XXH3:
+            return hash_xxh3;
+#ifdef HASHFN_X86
+        case HASHFN_CRC32C:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("sse4.2") ? hash_crc32c : NULL;
+#endif
+        default:
+            return NULL;
+    }
+}
+
+// Hashes a number with the selected function
+uint32_t hashfn(int number)
+{
+    return hash_active(number);
+}
+
+// Multiplies the number by 2^32 / Phi (golden number)
+uint32_t hash_fibonacci(int number)
+{
+    return (uint32_t) number * 2654435761u;
+}
+
+// MurmurHash3's fmix32
+uint32_t hash_murmur3(int number)
+{
+    uint32_t h = (uint32_t) number;
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+    return h;
+}
+
+// XXH3's rrmxmx mix of a 4 byte input, the key repeated in both halves of
+// a 64-bit word and xored with a fixed secret, keeping the top 32 bits
+uint32_t hash_xxh3(int number)
+{
+    uint64_t x = (uint32_t) number;
+    uint64_t h = (x + (x << 32)) ^ 0xC73AB174C5ECD5A2ull;
+    h ^= ((h << 49) | (h >> 15)) ^ ((h << 24) | (h >> 40));
+    h *= 0x9FB21C651E98DF25ull;
+    h ^= (h >> 35) + 4;
+    h *= 0x9FB21C651E98DF25ull;
+    h ^= h >> 28;
+    return (uint32_t) (h >> 32);
+}
+
+#ifdef HASHFN_X86
+
+// CRC32C of the number's 4 bytes, with the sse4.2 crc32 instruction
+__attribute__((target("sse4.2")))
+uint32_t hash_crc32c(int number)
+{
+    return _mm_crc32_u32(0xFFFFFFFFu, (uint32_t) number);
+}
+
+#endif
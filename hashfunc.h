@@ -0,0 +1,23 @@
+#ifndef HASHFUNC_H
+#define HASHFUNC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Hash functions the chained hash table can use
+#define HASHFN_FIBONACCI 0
+#define HASHFN_MURMUR3 1
+#define HASHFN_XXH3 2
+#define HASHFN_CRC32C 3
+#define HASHFN_COUNT 4
+
+// A hash function, spreading a number over all 32 bits
+typedef uint32_t (*hash_fn)(int number);
+
+bool hashfn_select(int kind);
+int hashfn_find(const char *name);
+const char *hashfn_name(int kind);
+hash_fn hashfn_get(int kind);
+uint32_t hashfn(int number);
+
+#endif
@@ -4,89 +4,301 @@
 // Has time complexity for insertion, searching and deletion close to O(1) in this implementation
 // In the worst case, it could have a time complexity for O(n) in all cases
 
-// Currently the standard deviation for this specific program is σ = 0.007745 with a dataset of 50k numbers
+// The bucket array starts small, doubles when there are more numbers than
+// buckets and halves when fewer than one in eight buckets would be used.
+// A resize doesn't move every chain at once: the old array is kept next
+// to the new one and every insert or delete moves the next few buckets
+// across, so the work is spread over many operations instead of stalling
+// one of them. While both arrays exist, buckets below the migration point
+// live in the new array and the rest in the old one, so every number
+// still has exactly one chain. Lookups never move buckets, which keeps
+// them read-only
+
+// Nodes come from a pool of large slabs owned by the table (pool.h), so an
+// insert doesn't call malloc, nodes inserted one after another sit next
+// to each other, a deleted node is reused by the next insert, and unloading
+// frees the slabs instead of walking every chain
+
+// The number of resizes, and with -s the longest pause one caused, are
+// printed with the standard deviation after loading; the benchmark prints
+// them again with hash_resizes once the searches are done
 
 
 #include "hashing.h"
-// Function prototypes
-unsigned int hash(int number);
-void hash_delete(hashnode *n, hashnode *prev, int key);
-void std_deviation(void);
 
-// Global variables
-unsigned int numberCount = 0;
+// Everything one hash table owns
+struct hashtable
+{
+    hashnode **table;
+    unsigned int size;
+    // bucket array being migrated, and how many of its buckets have moved
+    hashnode **old;
+    unsigned int oldSize;
+    unsigned int migrated;
+    unsigned int numberCount;
+    // resizes started since loading, and the longest operation one caused (only timed with -s)
+    unsigned int resizes;
+    uint64_t worstPause;
+    // the nodes, and the memory held by the hash table, bucket arrays and slabs included
+    pool nodes;
+    memstats mem;
+};
+
+// How far ahead batched inserts prefetch
+#define HASH_PREFETCH 8
+
+// Steps of an interleaved lookup: its bucket was prefetched, its current
+// node was prefetched, or the slot has no lookup left to run
+#define LOOKUP_BUCKET 0
+#define LOOKUP_NODE 1
+#define LOOKUP_IDLE 2
+
+// One lookup in flight in hash_contains_window
+typedef struct lookup
+{
+    size_t query;
+    int stage;
+    hashnode **bucket;
+    hashnode *node;
+} lookup;
+
+// Function prototypes
+bool hash_ingest(void *t, int number);
+unsigned int hash(int number, unsigned int size);
+hashnode **hash_bucket(const hashtable *t, int number);
+bool hash_lookup_start(const hashtable *t, lookup *l, const int *keys, size_t n, size_t *next);
+void hash_delete(hashtable *t, hashnode *n, hashnode *prev, hashnode **bucket);
+void hash_maintain(hashtable *t);
+bool hash_resize(hashtable *t, unsigned int size);
+void hash_rehash(hashtable *t, unsigned int buckets);
+void std_deviation(hashtable *t);
 
-// N is a prime number close to the size of the dataset
-const unsigned int N = 9999991;
+// Creates an empty hash table, returning NULL if out of memory
+// The bucket array is allocated with the first number
+hashtable *hash_create(void)
+{
+    hashtable *t = calloc(1, sizeof(hashtable));
+    if (t != NULL)
+    {
+        pool_init(&t->nodes, sizeof(hashnode));
+    }
+    return t;
+}
 
-// Hash table
-hashnode *table[N] = {NULL};
+// Frees the hash table and every number left in it
+void hash_destroy(hashtable *t)
+{
+    if (t != NULL)
+    {
+        hash_unload(t);
+        free(t);
+    }
+}
 
 // Loads database into memory, returning true if successful, else false
-bool hash_insert(const char *data_file)
+bool hash_insert(hashtable *t, const char *data_file)
+{
+    mem_reset(&t->mem);
+    t->resizes = 0;
+    t->worstPause = 0;
+
+    if (!ingest(data_file, hash_ingest, t))
+    {
+        hash_unload(t);
+        return false;
+    }
+
+    // Calculate the Std Deviation
+    std_deviation(t);
+    hash_resizes(t, "LOADING");
+    return true;
+}
+
+// Adds a single number to the hash table, returning false if out of memory
+bool hash_add(hashtable *t, int number)
 {
-    // open data file
-    FILE *inptr = fopen(data_file, "r");
-    if (inptr == NULL)
+    if (t->table == NULL && !hash_resize(t, HASH_MIN_BUCKETS))
+    {
+        return false;
+    }
+
+    hashnode *n = pool_alloc(&t->nodes, &t->mem);
+    if (n == NULL)
     {
-        printf("Could not open %s.\n", data_file);
         return false;
     }
 
-    // create a buffer
-    int buffer;
+    n->number = number;
+    n->next = NULL;
+    t->numberCount++;
+    hash_maintain(t);
+
+    // prepend to the head of the list of whichever array holds its bucket now
+    hashnode **bucket = hash_bucket(t, number);
+    n->next = *bucket;
+    *bucket = n;
+    return true;
+}
 
-    // Build list until reach the end of file
-    while(fscanf(inptr, "%i", &buffer) != EOF)
+// Adds n numbers, returning false if out of memory
+// The bucket of the key HASH_PREFETCH places ahead is prefetched while
+// the current key is prepended, so the bucket array misses overlap
+bool hash_add_batch(hashtable *t, const int *keys, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
     {
-        hashnode *n = calloc(1, sizeof(hashnode));
-        if (n == NULL)
+        if (i + HASH_PREFETCH < n && t->table != NULL)
+        {
+            __builtin_prefetch(hash_bucket(t, keys[i + HASH_PREFETCH]), 1);
+        }
+        if (!hash_add(t, keys[i]))
         {
-            hash_unload();
             return false;
         }
+    }
+    return true;
+}
+
+// hash_add in the shape ingest calls it
+bool hash_ingest(void *t, int number)
+{
+    return hash_add(t, number);
+}
+
+// Returns the allocation counters of the hash table
+memstats *hash_memory(hashtable *t)
+{
+    return &t->mem;
+}
 
-        n->number = buffer;
-        n->next = NULL;
+// Searches for a number and deletes it if found, the benchmark's fused operation
+bool hash_search(hashtable *t, int numbers)
+{
+    return hash_remove(t, numbers);
+}
 
-        // hash word to obtain hash value
-        unsigned int key = hash(n->number);
-        numberCount++;
+// Returns true if number is in the hash table, leaving the table untouched
+bool hash_contains(hashtable *t, int number)
+{
+    if (t->table == NULL)
+    {
+        return false;
+    }
 
-        // if at the start of the list
-        if (table[key] == NULL)
+    for (hashnode *n = *hash_bucket(t, number); n != NULL; n = n->next)
+    {
+        if (n->number == number)
         {
-            table[key] = n;
+            return true;
         }
+    }
+    return false;
+}
 
-        // else just prepend to the head of the list
-        else
+// Looks up n numbers, setting found[i] for each, and returns how many were found
+size_t hash_contains_batch(hashtable *t, const int *keys, size_t n, bool *found)
+{
+    return hash_contains_window(t, keys, n, found, HASH_WINDOW);
+}
+
+// Looks up n numbers like hash_contains_batch, with up to window lookups in flight
+// Every lookup is a small state machine that does one step and then lets
+// the next one run: hash the key and prefetch its bucket, read the bucket
+// and prefetch the first node, then compare one node and prefetch the next.
+// By the time the round comes back to a lookup its prefetch has usually
+// landed, so the cache misses of window lookups overlap instead of
+// following one another, and a long chain only holds up its own slot
+size_t hash_contains_window(hashtable *t, const int *keys, size_t n, bool *found, int window)
+{
+    if (t->table == NULL)
+    {
+        memset(found, 0, n * sizeof(bool));
+        return 0;
+    }
+
+    window = (window < 1) ? 1 : (window > HASH_WINDOW_MAX) ? HASH_WINDOW_MAX : window;
+    window = ((size_t) window > n) ? (int) n : window;
+
+    lookup slots[HASH_WINDOW_MAX];
+    size_t next = 0, hits = 0;
+    int active = 0;
+    for (int i = 0; i < window; i++)
+    {
+        active += hash_lookup_start(t, &slots[i], keys, n, &next);
+    }
+
+    for (int i = 0; active > 0; i = (i + 1 == window) ? 0 : i + 1)
+    {
+        lookup *l = &slots[i];
+        if (l->stage == LOOKUP_BUCKET)
+        {
+            l->node = *l->bucket;
+            l->stage = LOOKUP_NODE;
+            if (l->node != NULL)
+            {
+                __builtin_prefetch(l->node);
+                continue;
+            }
+        }
+        else if (l->stage == LOOKUP_NODE && l->node->number != keys[l->query])
+        {
+            l->node = l->node->next;
+            if (l->node != NULL)
+            {
+                __builtin_prefetch(l->node);
+                continue;
+            }
+        }
+        else if (l->stage == LOOKUP_IDLE)
         {
-            n->next = table[key];
-            table[key] = n;
+            continue;
         }
+
+        // The lookup ended here, found or not, so the slot takes the next key
+        found[l->query] = (l->node != NULL);
+        hits += found[l->query];
+        active -= !hash_lookup_start(t, l, keys, n, &next);
     }
-    // Close the data file
-    fclose(inptr);
+    return hits;
+}
 
-    // Calculate the Std Deviation
-    std_deviation();
+// Starts the next of n lookups in slot l, hashing its key and prefetching
+// the bucket, or leaves the slot idle and returns false if none is left
+bool hash_lookup_start(const hashtable *t, lookup *l, const int *keys, size_t n, size_t *next)
+{
+    if (*next == n)
+    {
+        l->stage = LOOKUP_IDLE;
+        return false;
+    }
+    l->query = (*next)++;
+    l->bucket = hash_bucket(t, keys[l->query]);
+    l->stage = LOOKUP_BUCKET;
+    __builtin_prefetch(l->bucket);
     return true;
 }
 
-bool hash_search(int numbers)
+// Deletes number from the hash table, returning false if it wasn't there
+bool hash_remove(hashtable *t, int numbers)
 {
-    // Get hash value
-    unsigned int key = hash(numbers);
+    if (t->table == NULL)
+    {
+        return false;
+    }
+
+    // Get the bucket
+    hashnode **bucket = hash_bucket(t, numbers);
     hashnode *prev = NULL;
 
     // Loop through the list at the key value
-    for (hashnode *n = table[key]; n != NULL; n = n->next)
+    for (hashnode *n = *bucket; n != NULL; n = n->next)
     {
         if (n->number == numbers)
         {
             // Delete N and return true
-            hash_delete(n, prev, key);
+            hash_delete(t, n, prev, bucket);
+            t->numberCount--;
+            hash_maintain(t);
             return true;
         }
         prev = n;
@@ -94,45 +306,58 @@ bool hash_search(int numbers)
     return false;
 }
 
-void hash_unload(void)
+void hash_unload(hashtable *t)
 {
-    // Iterating through the entire hash table
-    for (int i = 0; i < N; i++)
+    // Free the arrays, then every node at once with their slabs
+    if (t->old != NULL)
     {
-        // if head of list is found
-        if (table[i] != NULL)
-        {
-            // reset head to null
-            hashnode *head = table[i];
-            table[i] = NULL;
-
-            // free memory inside the linked list until all values are NULL
-            while (head != NULL)
-            {
-                hashnode* cursor = head->next;
-                free(head);
-                head = cursor;
-            }
-        }
+        mem_free(&t->mem, t->old, t->oldSize * sizeof(hashnode *));
+    }
+    if (t->table != NULL)
+    {
+        mem_free(&t->mem, t->table, t->size * sizeof(hashnode *));
     }
+    pool_release(&t->nodes, &t->mem);
+    t->table = NULL;
+    t->old = NULL;
+    t->size = 0;
+    t->oldSize = 0;
+    t->migrated = 0;
+    t->numberCount = 0;
+    t->resizes = 0;
+    t->worstPause = 0;
 }
 
-unsigned int hash(int number)
+unsigned int hash(int number, unsigned int size)
 {
-    // Multiplying the number by a constant helps to produce a
-    // more uniform distribution for a dataset that doesn't have many duplicate values
+    // Hash the number with the selected function (hashfunc.c), and scale
+    // the result down to the size, which keeps the top bits, the best mixed
+    uint64_t product = hashfn(number);
+    return (unsigned int) ((product * size) >> 32);
+}
 
-    // multiply the number by 2^32 * Phi (golden number)
-    return (number * 2654435761) % N;
+// Returns the bucket number lives in: in the old array if a resize is
+// under way and its bucket there hasn't moved yet, else in the new one
+hashnode **hash_bucket(const hashtable *t, int number)
+{
+    if (t->old != NULL)
+    {
+        unsigned int key = hash(number, t->oldSize);
+        if (key >= t->migrated)
+        {
+            return &t->old[key];
+        }
+    }
+    return &t->table[hash(number, t->size)];
 }
 
 // Deletes number from the hash table
-void hash_delete(hashnode *n, hashnode *prev, int key)
+void hash_delete(hashtable *t, hashnode *n, hashnode *prev, hashnode **bucket)
 {
     // if head of the list
     if (prev == NULL)
     {
-        table[key] = n->next;
+        *bucket = n->next;
     }
     // if in the middle of the list
     else
@@ -140,41 +365,160 @@ void hash_delete(hashnode *n, hashnode *prev, int key)
         // skip N altogether
         prev->next = n->next;
     }
-    free(n);
+    pool_free(&t->nodes, n);
+}
+
+// Moves a few more buckets of a resize under way, or starts one if the
+// numbers went past a load threshold, and remembers the longest this took
+// A failed resize is not an error: the chains just get longer for now
+void hash_maintain(hashtable *t)
+{
+    unsigned int size = 0;
+    if (t->old == NULL)
+    {
+        if (t->numberCount > t->size * HASH_MAX_LOAD)
+        {
+            size = t->size * 2;
+        }
+        else if (t->size > HASH_MIN_BUCKETS && t->numberCount < t->size * HASH_MIN_LOAD)
+        {
+            size = t->size / 2;
+        }
+        else
+        {
+            return;
+        }
+    }
+
+    // the clock is only read while latencies are sampled, so plain runs
+    // don't pay for it on every step of a migration
+    bool timed = ingest_sampling();
+    uint64_t start = timed ? latency_ticks() : 0;
+    if (size == 0 || hash_resize(t, size))
+    {
+        hash_rehash(t, HASH_REHASH_STEP);
+    }
+    uint64_t pause = timed ? latency_ticks() - start : 0;
+    if (pause > t->worstPause)
+    {
+        t->worstPause = pause;
+    }
+}
+
+// Allocates a bucket array of size buckets and starts moving the numbers
+// into it, returning false if out of memory
+bool hash_resize(hashtable *t, unsigned int size)
+{
+    hashnode **table = mem_calloc(&t->mem, size, sizeof(hashnode *));
+    if (table == NULL)
+    {
+        return false;
+    }
+
+    // the first array has nothing to move
+    if (t->table != NULL)
+    {
+        t->old = t->table;
+        t->oldSize = t->size;
+        t->migrated = 0;
+        t->resizes++;
+    }
+    t->table = table;
+    t->size = size;
+    return true;
+}
+
+// Moves up to buckets buckets of the old array into the new one, and frees
+// the old array once it is empty
+void hash_rehash(hashtable *t, unsigned int buckets)
+{
+    for (; buckets > 0 && t->migrated < t->oldSize; buckets--, t->migrated++)
+    {
+        hashnode *n = t->old[t->migrated];
+        t->old[t->migrated] = NULL;
+        while (n != NULL)
+        {
+            hashnode *next = n->next;
+            unsigned int key = hash(n->number, t->size);
+            n->next = t->table[key];
+            t->table[key] = n;
+            n = next;
+        }
+    }
+
+    if (t->migrated == t->oldSize)
+    {
+        mem_free(&t->mem, t->old, t->oldSize * sizeof(hashnode *));
+        t->old = NULL;
+        t->oldSize = 0;
+        t->migrated = 0;
+    }
+}
+
+// Prints how often the table resized since the last report and, while
+// latencies are sampled, the longest single operation a resize caused,
+// then clears both
+// With a NULL phase they are only cleared
+void hash_resizes(hashtable *t, const char *phase)
+{
+    unsigned int size;
+    uint64_t pause;
+    unsigned int resizes = hash_resized(t, &size, &pause);
+    if (resizes > 0 && phase != NULL && ingest_sampling())
+    {
+        printf("     RESIZES WHILE %s: %u, now %u buckets, longest pause %.1f us\n",
+               phase, resizes, size, latency_ns(pause) / 1000.0);
+    }
+    else if (resizes > 0 && phase != NULL)
+    {
+        printf("     RESIZES WHILE %s: %u, now %u buckets\n", phase, resizes, size);
+    }
+}
+
+// Returns how often the table resized since the last report, setting size
+// to its buckets and pause to the longest operation a resize caused (in
+// ticks, 0 unless latencies are sampled), and clears both counters
+unsigned int hash_resized(hashtable *t, unsigned int *size, uint64_t *pause)
+{
+    unsigned int resizes = t->resizes;
+    *size = t->size;
+    *pause = t->worstPause;
+    t->resizes = 0;
+    t->worstPause = 0;
+    return resizes;
 }
 
 // Function that calculates the Std Deviation of the elements in the hash table
-void std_deviation(void)
+// While a resize is under way, the buckets still in the old array count as well
+void std_deviation(hashtable *t)
 {
+    unsigned int buckets = t->size + t->oldSize - t->migrated;
+    if (buckets < 2)
+    {
+        return;
+    }
+
     // Calculate average X as the division of the number count by the amount of 'buckets'
-    float Xm = (float) numberCount / N;
+    float Xm = (float) t->numberCount / buckets;
     // Sum of (Xi - Xm) squared
     float sum = 0;
 
     // Loop through the list at the key value
-    for (int i = 0; i < N; i++)
+    for (unsigned int i = 0; i < buckets; i++)
     {
         float Xi = 0;
-        // only check existing linked lists
-        if (table[i] != NULL)
-        {
-            // access the head of the linked list
-            hashnode *n = table[i];
+        // access the head of the linked list
+        hashnode *n = (i < t->size) ? t->table[i] : t->old[t->migrated + i - t->size];
 
-            // free memory inside the linked list until all values are NULL
-            while (n != NULL)
-            {
-                Xi++;
-                n = n->next;
-            }
-            sum += (Xi - Xm) * (Xi - Xm);
-        }
-        else
+        // count the numbers of the linked list until it ends
+        while (n != NULL)
         {
-            sum += Xm*Xm;
+            Xi++;
+            n = n->next;
         }
+        sum += (Xi - Xm) * (Xi - Xm);
     }
-    float result = sqrt(sum / (float) (N - 1));
+    float result = sqrt(sum / (float) (buckets - 1));
     printf("     =============\n");
     printf("     STD DEVIATION\n");
     printf("     σ = %f\n", result);
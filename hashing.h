@@ -3,8 +3,32 @@
 
 #include <math.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include "hashfunc.h"
+#include "ingest.h"
+#include "latency.h"
+#include "memory.h"
+#include "pool.h"
+
+// Smallest bucket array (the table never shrinks below it)
+#define HASH_MIN_BUCKETS 1024
+
+// The table doubles when it holds more numbers per bucket than HASH_MAX_LOAD,
+// and halves when it holds fewer than HASH_MIN_LOAD
+#define HASH_MAX_LOAD 1.0
+#define HASH_MIN_LOAD 0.125
+
+// Buckets a resize moves to the new array with every insert or delete
+#define HASH_REHASH_STEP 8
+
+// Lookups hash_contains_batch keeps in flight at once, and the most
+// hash_contains_window accepts
+#define HASH_WINDOW 16
+#define HASH_WINDOW_MAX 64
 
 // Represents a node in a hash table
 typedef struct hashnode
@@ -13,8 +37,22 @@ typedef struct hashnode
     struct hashnode *next;
 } hashnode;
 
-bool hash_insert(const char *data_file);
-bool hash_search(int numbers);
-void hash_unload(void);
+// A hash table, only handled through the functions below
+typedef struct hashtable hashtable;
+
+hashtable *hash_create(void);
+void hash_destroy(hashtable *t);
+bool hash_insert(hashtable *t, const char *data_file);
+bool hash_add(hashtable *t, int number);
+bool hash_add_batch(hashtable *t, const int *keys, size_t n);
+memstats *hash_memory(hashtable *t);
+bool hash_search(hashtable *t, int numbers);
+bool hash_contains(hashtable *t, int number);
+size_t hash_contains_batch(hashtable *t, const int *keys, size_t n, bool *found);
+size_t hash_contains_window(hashtable *t, const int *keys, size_t n, bool *found, int window);
+bool hash_remove(hashtable *t, int number);
+void hash_unload(hashtable *t);
+void hash_resizes(hashtable *t, const char *phase);
+unsigned int hash_resized(hashtable *t, unsigned int *size, uint64_t *pause);
 
 #endif
@@ -0,0 +1,259 @@
+// Feeds a dataset into a structure one key at a time
+
+// Serial ingest reads, parses and inserts on the calling thread.
+// Pipelined ingest moves reading and parsing to a second thread that fills
+// fixed-size batches of keys and pushes them through a lock-free
+// single-producer single-consumer ring, while the calling thread drains the
+// ring into the structure, so I/O and parsing overlap with the inserts
+
+// Either way every Nth insert can be timed on its own into a histogram,
+// a load can be cut short after a prefix of the dataset, and every key can
+// be handed to a tap (the Bloom filter of -F) on its way into the structure
+
+#define _DEFAULT_SOURCE
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ingest.h"
+#include "reader.h"
+
+// A batch of parsed keys
+typedef struct batch
+{
+    size_t count;
+    int keys[INGEST_BATCH];
+} batch;
+
+// Ring of batches shared by the reader thread and the builder
+// head and tail only ever grow, and live on separate cache lines
+typedef struct ring
+{
+    batch *slots;
+    reader *source;
+    _Alignas(64) atomic_size_t head;
+    _Alignas(64) atomic_size_t tail;
+    atomic_bool done;
+    atomic_bool stop;
+} ring;
+
+// Function prototypes
+bool ingest_serial(reader *r, bool (*add)(void *s, int number), void *s);
+bool ingest_pipelined(reader *r, bool (*add)(void *s, int number), void *s);
+void *ingest_produce(void *arg);
+bool ingest_add(bool (*add)(void *s, int number), void *s, int number);
+
+// Global variables
+bool ingest_threaded = false;
+size_t ingest_keys = 0;
+int ingest_every = 0;
+size_t ingest_max = 0;
+histogram *ingest_hist = NULL;
+void (*ingest_tapper)(void *f, int number) = NULL;
+void *ingest_tapped = NULL;
+
+// Loads every key of data_file into the structure s through add,
+// returning true if successful, else false
+bool ingest(const char *data_file, bool (*add)(void *s, int number), void *s)
+{
+    ingest_keys = 0;
+
+    // map data file
+    reader r;
+    if (!reader_open(&r, data_file))
+    {
+        printf("Could not open %s.\n", data_file);
+        return false;
+    }
+
+    bool loaded = ingest_threaded ? ingest_pipelined(&r, add, s) : ingest_serial(&r, add, s);
+
+    // Unmap the data file
+    reader_close(&r);
+    return loaded;
+}
+
+// Chooses between serial and pipelined ingest for every following load
+void ingest_pipeline(bool enabled)
+{
+    ingest_threaded = enabled;
+}
+
+// Returns how many keys the last load inserted
+size_t ingest_count(void)
+{
+    return ingest_keys;
+}
+
+// Stops every following load after max keys, or reads whole files if max is 0
+void ingest_limit(size_t max)
+{
+    ingest_max = max;
+}
+
+// Returns how many keys loading data_file will insert, or 0 if it can't be opened
+// Text files are counted by their lines, so blank lines count as keys too
+size_t ingest_expected(const char *data_file)
+{
+    reader r;
+    if (!reader_open(&r, data_file))
+    {
+        return 0;
+    }
+    size_t keys = reader_count(&r);
+    reader_close(&r);
+    return (ingest_max > 0 && ingest_max < keys) ? ingest_max : keys;
+}
+
+// Hands every key of the following loads to tap as well, before the
+// structure gets it, or stops if tap is NULL
+void ingest_tap(void (*tap)(void *f, int number), void *f)
+{
+    ingest_tapper = tap;
+    ingest_tapped = f;
+}
+
+// Times every Nth insert into h, or stops sampling if every is 0
+void ingest_sample(int every, histogram *h)
+{
+    ingest_every = (h != NULL) ? every : 0;
+    ingest_hist = h;
+}
+
+// Returns true while latencies are being sampled
+bool ingest_sampling(void)
+{
+    return ingest_every > 0;
+}
+
+// Inserts one key, timing it if it is due to be sampled
+bool ingest_add(bool (*add)(void *s, int number), void *s, int number)
+{
+    if (ingest_tapper != NULL)
+    {
+        ingest_tapper(ingest_tapped, number);
+    }
+    if (ingest_every == 0 || ingest_keys % ingest_every != 0)
+    {
+        return add(s, number);
+    }
+
+    uint64_t start = latency_ticks();
+    bool added = add(s, number);
+    hist_record(ingest_hist, latency_ticks() - start);
+    return added;
+}
+
+// Reads and inserts on the calling thread
+bool ingest_serial(reader *r, bool (*add)(void *s, int number), void *s)
+{
+    // create a buffer
+    int buffer;
+
+    // Build structure until reach the end of file (or the limit)
+    while ((ingest_max == 0 || ingest_keys < ingest_max) && reader_next(r, &buffer))
+    {
+        if (!ingest_add(add, s, buffer))
+        {
+            return false;
+        }
+        ingest_keys++;
+    }
+    return true;
+}
+
+// Inserts batches pushed by a reader thread
+bool ingest_pipelined(reader *r, bool (*add)(void *s, int number), void *s)
+{
+    ring q;
+    q.slots = malloc(INGEST_SLOTS * sizeof(batch));
+    if (q.slots == NULL)
+    {
+        return false;
+    }
+    q.source = r;
+    atomic_init(&q.head, 0);
+    atomic_init(&q.tail, 0);
+    atomic_init(&q.done, false);
+    atomic_init(&q.stop, false);
+
+    pthread_t producer;
+    if (pthread_create(&producer, NULL, ingest_produce, &q) != 0)
+    {
+        free(q.slots);
+        return false;
+    }
+
+    bool loaded = true, full = false;
+    size_t tail = 0;
+    while (loaded && !full)
+    {
+        size_t head = atomic_load_explicit(&q.head, memory_order_acquire);
+
+        // ring is empty
+        if (tail == head)
+        {
+            // the reader publishes its last batch before raising done,
+            // so head has to be checked once more after seeing it
+            if (atomic_load_explicit(&q.done, memory_order_acquire) &&
+                atomic_load_explicit(&q.head, memory_order_acquire) == tail)
+            {
+                break;
+            }
+            sched_yield();
+            continue;
+        }
+
+        batch *b = &q.slots[tail % INGEST_SLOTS];
+        for (size_t i = 0; i < b->count && !full; i++)
+        {
+            if (!ingest_add(add, s, b->keys[i]))
+            {
+                loaded = false;
+                break;
+            }
+            ingest_keys++;
+            full = (ingest_max > 0 && ingest_keys == ingest_max);
+        }
+
+        // hand the slot back to the reader
+        atomic_store_explicit(&q.tail, ++tail, memory_order_release);
+    }
+
+    // tell the reader to give up if the builder failed or has enough keys
+    atomic_store_explicit(&q.stop, true, memory_order_relaxed);
+    pthread_join(producer, NULL);
+    free(q.slots);
+    return loaded;
+}
+
+// Reader thread: parses the dataset into batches until it runs out of keys
+void *ingest_produce(void *arg)
+{
+    ring *q = arg;
+    size_t head = 0;
+
+    while (!atomic_load_explicit(&q->stop, memory_order_relaxed))
+    {
+        // wait for the builder to free a slot
+        if (head - atomic_load_explicit(&q->tail, memory_order_acquire) == INGEST_SLOTS)
+        {
+            sched_yield();
+            continue;
+        }
+
+        batch *b = &q->slots[head % INGEST_SLOTS];
+        b->count = reader_fill(q->source, b->keys, INGEST_BATCH);
+        if (b->count == 0)
+        {
+            break;
+        }
+        atomic_store_explicit(&q->head, ++head, memory_order_release);
+    }
+
+    atomic_store_explicit(&q->done, true, memory_order_release);
+    return NULL;
+}
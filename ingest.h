@@ -0,0 +1,24 @@
+#ifndef INGEST_H
+#define INGEST_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "latency.h"
+
+// Keys handed from the reader thread to the builder in one go
+#define INGEST_BATCH 4096
+
+// Batches the reader thread may run ahead of the builder
+#define INGEST_SLOTS 64
+
+bool ingest(const char *data_file, bool (*add)(void *s, int number), void *s);
+void ingest_pipeline(bool enabled);
+size_t ingest_count(void);
+void ingest_sample(int every, histogram *h);
+bool ingest_sampling(void);
+void ingest_limit(size_t max);
+size_t ingest_expected(const char *data_file);
+void ingest_tap(void (*tap)(void *f, int number), void *f);
+
+#endif
@@ -0,0 +1,191 @@
+// Low overhead per-operation timer and latency histograms
+
+// The timer reads the TSC when the CPU has an invariant one, calibrated
+// once against CLOCK_MONOTONIC_RAW, and falls back to CLOCK_MONOTONIC_RAW
+// itself otherwise. Raw ticks are only converted to nanoseconds when they
+// are recorded, outside the timed region
+
+// Histograms are HDR-style: values below 2 * LATENCY_SUB get a bucket of
+// their own, larger ones share a bucket with values of the same power of
+// two and the same top LATENCY_SUB_BITS + 1 bits
+
+#define _GNU_SOURCE
+
+#include <string.h>
+#include <time.h>
+
+#include "latency.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define LATENCY_TSC
+#endif
+
+// Function prototypes
+uint64_t monotonic_ns(void);
+int hist_index(uint64_t value);
+uint64_t hist_upper(int index);
+
+// Global variables
+bool latency_tsc = false;
+double latency_scale = 1.0;
+
+// Picks the clock and calibrates the TSC against CLOCK_MONOTONIC_RAW
+void latency_init(void)
+{
+#ifdef LATENCY_TSC
+    // CPUID leaf 0x80000007, EDX bit 8: the TSC ticks at a constant rate
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) && (edx & (1 << 8)))
+    {
+        uint64_t ns_before = monotonic_ns();
+        uint64_t tsc_before = __rdtsc();
+
+        // spin for ~20ms, long enough for a stable ratio
+        while (monotonic_ns() - ns_before < 20000000)
+        {
+        }
+
+        uint64_t ns = monotonic_ns() - ns_before;
+        uint64_t ticks = __rdtsc() - tsc_before;
+        if (ticks > 0)
+        {
+            latency_scale = (double) ns / ticks;
+            latency_tsc = true;
+            return;
+        }
+    }
+#endif
+    latency_tsc = false;
+    latency_scale = 1.0;
+}
+
+// Returns the name of the clock in use
+const char *latency_clock(void)
+{
+    return latency_tsc ? "tsc" : "CLOCK_MONOTONIC_RAW";
+}
+
+// Returns the current time in raw ticks
+uint64_t latency_ticks(void)
+{
+#ifdef LATENCY_TSC
+    if (latency_tsc)
+    {
+        // rdtscp waits for the preceding instructions to finish
+        unsigned int aux;
+        return __rdtscp(&aux);
+    }
+#endif
+    return monotonic_ns();
+}
+
+// Converts a number of ticks to nanoseconds
+double latency_ns(uint64_t ticks)
+{
+    return ticks * latency_scale;
+}
+
+// Reads CLOCK_MONOTONIC_RAW in nanoseconds
+uint64_t monotonic_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Empties a histogram
+void hist_reset(histogram *h)
+{
+    memset(h, 0, sizeof(histogram));
+}
+
+// Records the latency of one operation, measured in ticks
+void hist_record(histogram *h, uint64_t ticks)
+{
+    uint64_t ns = (uint64_t) latency_ns(ticks);
+
+    h->counts[hist_index(ns)]++;
+    if (h->samples == 0 || ns < h->min)
+    {
+        h->min = ns;
+    }
+    if (ns > h->max)
+    {
+        h->max = ns;
+    }
+    h->sum += ns;
+    h->samples++;
+}
+
+// Returns the smallest latency at or above the given percentile (0-100)
+uint64_t hist_percentile(const histogram *h, double percentile)
+{
+    if (h->samples == 0)
+    {
+        return 0;
+    }
+
+    // rank of the sample the percentile falls on, counting from 1
+    uint64_t rank = (uint64_t) (percentile / 100.0 * h->samples + 0.5);
+    if (rank < 1)
+    {
+        rank = 1;
+    }
+
+    uint64_t seen = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++)
+    {
+        seen += h->counts[i];
+        if (seen >= rank)
+        {
+            // never report more than was actually recorded
+            uint64_t upper = hist_upper(i);
+            return upper < h->max ? upper : h->max;
+        }
+    }
+    return h->max;
+}
+
+// Prints one row of the latency table
+void hist_print(const histogram *h, const char *phase)
+{
+    if (h->samples == 0)
+    {
+        return;
+    }
+    printf("%-8s %9llu %9llu %9.0f %9llu %9llu %9llu %9llu\n", phase,
+           (unsigned long long) h->samples, (unsigned long long) h->min, h->sum / h->samples,
+           (unsigned long long) hist_percentile(h, 50.0),
+           (unsigned long long) hist_percentile(h, 99.0),
+           (unsigned long long) hist_percentile(h, 99.9),
+           (unsigned long long) h->max);
+}
+
+// Returns the bucket a value belongs to
+int hist_index(uint64_t value)
+{
+    if (value < 2 * LATENCY_SUB)
+    {
+        return (int) value;
+    }
+
+    // keep the top LATENCY_SUB_BITS + 1 bits, scaled by the power of two
+    int magnitude = 63 - __builtin_clzll(value);
+    int shift = magnitude - LATENCY_SUB_BITS;
+    return shift * LATENCY_SUB + (int) (value >> shift);
+}
+
+// Returns the highest value that falls in a bucket
+uint64_t hist_upper(int index)
+{
+    if (index < 2 * LATENCY_SUB)
+    {
+        return index;
+    }
+
+    int shift = index / LATENCY_SUB - 1;
+    uint64_t top = (uint64_t) (index - shift * LATENCY_SUB);
+    return ((top + 1) << shift) - 1;
+}
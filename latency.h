@@ -0,0 +1,34 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Each power of two is split into this many linear sub-buckets (2^5),
+// so every recorded value is within ~3% of its bucket's bounds
+#define LATENCY_SUB_BITS 5
+#define LATENCY_SUB (1 << LATENCY_SUB_BITS)
+#define LATENCY_BUCKETS ((64 - LATENCY_SUB_BITS + 1) * LATENCY_SUB)
+
+// Log-bucketed histogram of latencies in nanoseconds
+typedef struct histogram
+{
+    uint64_t counts[LATENCY_BUCKETS];
+    uint64_t samples;
+    uint64_t min;
+    uint64_t max;
+    double sum;
+} histogram;
+
+void latency_init(void);
+const char *latency_clock(void);
+uint64_t latency_ticks(void);
+double latency_ns(uint64_t ticks);
+
+void hist_reset(histogram *h);
+void hist_record(histogram *h, uint64_t ticks);
+uint64_t hist_percentile(const histogram *h, double percentile);
+void hist_print(const histogram *h, const char *phase);
+
+#endif
@@ -0,0 +1,634 @@
+// Lock-free hash table (split-ordered list) that any number of threads can load,
+// search and delete from at the same time
+
+// Every number sits in one sorted lock-free linked list (Harris and Michael:
+// a node is deleted by first marking its next pointer, then unlinking it),
+// ordered by its hash. The buckets are shortcuts into that list: a number's
+// bucket is its hash with the bits reversed, so it follows the hash's top
+// bits like every other table, and bucket b points at a dummy node sorted
+// right before the numbers whose hash starts with b reversed. Doubling the
+// buckets only makes the mask one bit wider. Nothing moves: a new bucket gets its dummy the first time it is
+// used, linked in after the dummy of its parent (b without its highest
+// bit), so the table grows without stopping any thread. The bucket array
+// is a list of segments, each twice the size of the last, so it never has
+// to be copied either
+
+// A node unlinked by one thread may still be read by another, so it is only
+// reused once no thread can reach it (epoch-based reclamation). Every
+// operation announces the global epoch it started in; a node is retired
+// into a list of its thread tagged with that epoch, and every LF_RECLAIM
+// retirements the thread tries to advance the epoch, which only succeeds
+// once every thread inside an operation has announced the current one.
+// Three epochs later no thread can still hold the node, and it goes into
+// the pool of the thread that retired it, whichever one allocated it
+
+// Announcing needs a full fence before the operation reads the list, which
+// stalls every lookup until its earlier loads and stores drain. On Linux the
+// fence moves to the rare thread advancing the epoch instead: membarrier()
+// makes every other thread of the process run one, so lookups only need to
+// keep the compiler from reordering
+
+// Each thread carves nodes out of its own pool (pool.h) and keeps its own
+// memory counters; only their sums over the threads mean anything
+
+// Like the AVL tree, the table holds each number once
+
+// Unloading and destroying the table must not overlap with anything else
+
+#define _DEFAULT_SOURCE
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "lockfree_hash.h"
+
+#ifdef __linux__
+#include <linux/membarrier.h>
+#include <sys/syscall.h>
+#endif
+
+// A bucket: its dummy node, or NULL until the bucket is first used
+typedef _Atomic(lfnode *) lfbucket;
+
+// What a thread keeps in one table, on cache lines of its own
+typedef struct lfthread
+{
+    // (epoch << 1) | 1 while inside an operation, 0 outside
+    _Alignas(64) atomic_size_t active;
+    // the epoch of its last operation, and the nodes retired in the last three
+    size_t epoch;
+    lfnode *limbo[3];
+    size_t retired;
+    pool nodes;
+    memstats mem;
+} lfthread;
+
+// Everything one hash table owns
+struct lftable
+{
+    lfthread threads[LF_THREADS];
+    _Alignas(64) atomic_size_t epoch;
+    atomic_size_t size;
+    atomic_size_t count;
+    _Atomic(lfbucket *) segments[LF_SEGMENTS];
+    // what lf_memory adds up over the threads
+    memstats total;
+};
+
+// Function prototypes
+bool lf_ingest(void *t, int number);
+int lf_thread(void);
+void lf_key_create(void);
+void lf_release(void *taken);
+lfthread *lf_enter(lftable *t);
+void lf_exit(lfthread *r);
+void lf_retire(lftable *t, lfthread *r, lfnode *n);
+void lf_advance(lftable *t);
+uint32_t lf_reverse(uint32_t bits);
+size_t lf_locate(size_t b, int *segment, size_t *offset);
+lfbucket *lf_slot(lftable *t, lfthread *r, size_t b);
+lfnode *lf_bucket(lftable *t, lfthread *r, size_t b);
+lfnode *lf_nearest(lftable *t, size_t b);
+bool lf_find(lftable *t, lfthread *r, lfnode *head, uint64_t key, int number, _Atomic(uintptr_t) **prev,
+             lfnode **cur);
+lfnode *lf_link(lftable *t, lfthread *r, lfnode *head, lfnode *n);
+
+// Global variables
+// thread numbers in use, and the key that hands a thread's number back when it exits
+atomic_bool lf_taken[LF_THREADS];
+pthread_key_t lf_key;
+pthread_once_t lf_once = PTHREAD_ONCE_INIT;
+_Thread_local int lf_id = -1;
+// whether membarrier() stands in for the fence of every operation
+bool lf_membarrier = false;
+
+// Creates an empty hash table, returning NULL if out of memory
+// The buckets are allocated as they are first used
+lftable *lf_create(void)
+{
+    lftable *t = aligned_alloc(_Alignof(lftable), sizeof(lftable));
+    if (t == NULL)
+    {
+        return NULL;
+    }
+    memset(t, 0, sizeof(lftable));
+    for (int i = 0; i < LF_THREADS; i++)
+    {
+        atomic_init(&t->threads[i].active, 0);
+        pool_init(&t->threads[i].nodes, sizeof(lfnode));
+    }
+    for (int i = 0; i < LF_SEGMENTS; i++)
+    {
+        atomic_init(&t->segments[i], NULL);
+    }
+    atomic_init(&t->epoch, 0);
+    atomic_init(&t->size, LF_MIN_BUCKETS);
+    atomic_init(&t->count, 0);
+    return t;
+}
+
+// Frees the hash table and every number left in it
+void lf_destroy(lftable *t)
+{
+    if (t != NULL)
+    {
+        lf_unload(t);
+        free(t);
+    }
+}
+
+// Loads database into memory, returning true if successful, else false
+bool lf_insert(lftable *t, const char *data_file)
+{
+    for (int i = 0; i < LF_THREADS; i++)
+    {
+        mem_reset(&t->threads[i].mem);
+    }
+
+    if (!ingest(data_file, lf_ingest, t))
+    {
+        lf_unload(t);
+        return false;
+    }
+    return true;
+}
+
+// Adds a single number to the hash table, returning false if out of memory
+bool lf_add(lftable *t, int number)
+{
+    lfthread *r = lf_enter(t);
+    if (r == NULL)
+    {
+        return false;
+    }
+
+    uint32_t h = hashfn(number);
+    size_t size = atomic_load_explicit(&t->size, memory_order_relaxed);
+    lfnode *head = lf_bucket(t, r, lf_reverse(h) & (size - 1));
+    lfnode *n = (head != NULL) ? pool_alloc(&r->nodes, &r->mem) : NULL;
+    if (n == NULL)
+    {
+        lf_exit(r);
+        return false;
+    }
+    n->key = ((uint64_t) h << 1) | 1;
+    n->number = number;
+    atomic_init(&n->next, 0);
+
+    if (lf_link(t, r, head, n) != n)
+    {
+        // already there, and nobody else ever saw the new node
+        pool_free(&r->nodes, n);
+    }
+    else if (atomic_fetch_add(&t->count, 1) + 1 > size * LF_MAX_LOAD && size < ((size_t) 1 << 32))
+    {
+        // if another thread doubled it first, this one has nothing left to do
+        atomic_compare_exchange_strong(&t->size, &size, size * 2);
+    }
+    lf_exit(r);
+    return true;
+}
+
+// Adds n numbers, returning false if out of memory
+bool lf_add_batch(lftable *t, const int *keys, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        if (!lf_add(t, keys[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// lf_add in the shape ingest calls it
+bool lf_ingest(void *t, int number)
+{
+    return lf_add(t, number);
+}
+
+// Returns the allocation counters of the table, added up over the threads
+// Every thread reaches its peak at a different moment, so the peak is an upper bound
+memstats *lf_memory(lftable *t)
+{
+    memset(&t->total, 0, sizeof(memstats));
+    for (int i = 0; i < LF_THREADS; i++)
+    {
+        const memstats *m = &t->threads[i].mem;
+        t->total.live += m->live;
+        t->total.peak += m->peak;
+        t->total.allocations += m->allocations;
+        t->total.frees += m->frees;
+    }
+    return &t->total;
+}
+
+// Searches for a number and deletes it if found, the benchmark's fused operation
+bool lf_search(lftable *t, int numbers)
+{
+    return lf_remove(t, numbers);
+}
+
+// Returns true if number is in the hash table
+// Like removing, it never links in a bucket, so reading leaves the table untouched
+bool lf_contains(lftable *t, int number)
+{
+    lfthread *r = lf_enter(t);
+    if (r == NULL)
+    {
+        return false;
+    }
+
+    uint32_t h = hashfn(number);
+    lfnode *head = lf_nearest(t, lf_reverse(h) & (atomic_load_explicit(&t->size, memory_order_relaxed) - 1));
+    _Atomic(uintptr_t) *prev;
+    lfnode *cur;
+    bool found = head != NULL && lf_find(t, r, head, ((uint64_t) h << 1) | 1, number, &prev, &cur);
+    lf_exit(r);
+    return found;
+}
+
+// Looks up n numbers, setting found[i] for each, and returns how many were found
+size_t lf_contains_batch(lftable *t, const int *keys, size_t n, bool *found)
+{
+    size_t hits = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        found[i] = lf_contains(t, keys[i]);
+        hits += found[i];
+    }
+    return hits;
+}
+
+// Deletes number from the hash table, returning false if it wasn't there
+// Whoever marks the node deleted the number, whoever unlinks it retires it
+bool lf_remove(lftable *t, int number)
+{
+    lfthread *r = lf_enter(t);
+    if (r == NULL)
+    {
+        return false;
+    }
+
+    uint32_t h = hashfn(number);
+    lfnode *head = lf_nearest(t, lf_reverse(h) & (atomic_load_explicit(&t->size, memory_order_relaxed) - 1));
+    uint64_t key = ((uint64_t) h << 1) | 1;
+    bool removed = false;
+    _Atomic(uintptr_t) *prev;
+    lfnode *cur;
+    while (!removed && head != NULL && lf_find(t, r, head, key, number, &prev, &cur))
+    {
+        uintptr_t next = atomic_load(&cur->next);
+        if ((next & 1) == 0 && atomic_compare_exchange_strong(&cur->next, &next, next | 1))
+        {
+            removed = true;
+            uintptr_t expected = (uintptr_t) cur;
+            if (atomic_compare_exchange_strong(prev, &expected, next))
+            {
+                lf_retire(t, r, cur);
+            }
+            else
+            {
+                // the list changed around it, so let a fresh search unlink it
+                lf_find(t, r, head, key, number, &prev, &cur);
+            }
+        }
+    }
+    if (removed)
+    {
+        atomic_fetch_sub(&t->count, 1);
+    }
+    lf_exit(r);
+    return removed;
+}
+
+// Frees the buckets and every node, leaving an empty table
+void lf_unload(lftable *t)
+{
+    int id = lf_thread();
+    memstats *m = &t->threads[(id >= 0) ? id : 0].mem;
+    for (int i = 0; i < LF_SEGMENTS; i++)
+    {
+        lfbucket *buckets = atomic_load(&t->segments[i]);
+        if (buckets != NULL)
+        {
+            int segment;
+            size_t offset;
+            size_t length = lf_locate((i == 0) ? 0 : (size_t) LF_MIN_BUCKETS << (i - 1), &segment, &offset);
+            mem_free(m, buckets, length * sizeof(lfbucket));
+        }
+        atomic_store(&t->segments[i], NULL);
+    }
+
+    // the retired nodes go with the slabs they were carved from
+    for (int i = 0; i < LF_THREADS; i++)
+    {
+        lfthread *r = &t->threads[i];
+        pool_release(&r->nodes, &r->mem);
+        memset(r->limbo, 0, sizeof(r->limbo));
+        r->retired = 0;
+    }
+    atomic_store(&t->size, LF_MIN_BUCKETS);
+    atomic_store(&t->count, 0);
+}
+
+// Returns the number of the calling thread, the same for every table,
+// taking a free one on its first call, or -1 if LF_THREADS threads have one
+int lf_thread(void)
+{
+    if (lf_id < 0)
+    {
+        pthread_once(&lf_once, lf_key_create);
+        for (int i = 0; i < LF_THREADS && lf_id < 0; i++)
+        {
+            if (!atomic_exchange(&lf_taken[i], true))
+            {
+                lf_id = i;
+                pthread_setspecific(lf_key, &lf_taken[i]);
+            }
+        }
+    }
+    return lf_id;
+}
+
+// Creates the key whose destructor frees a thread's number when it exits,
+// and sets membarrier() up if the kernel has it
+void lf_key_create(void)
+{
+    pthread_key_create(&lf_key, lf_release);
+#ifdef __linux__
+    lf_membarrier = syscall(SYS_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0, 0) == 0;
+#endif
+}
+
+// Hands an exiting thread's number to the next thread that needs one
+void lf_release(void *taken)
+{
+    atomic_store((atomic_bool *) taken, false);
+}
+
+// Starts an operation of the calling thread, returning its record, or NULL
+// if too many threads use the tables
+// Announces the current epoch, then reuses the nodes it retired three epochs ago
+lfthread *lf_enter(lftable *t)
+{
+    int id = lf_thread();
+    if (id < 0)
+    {
+        printf("More than %d threads use the lock-free hash table.\n", LF_THREADS);
+        return NULL;
+    }
+
+    lfthread *r = &t->threads[id];
+    size_t epoch = atomic_load(&t->epoch);
+    atomic_store_explicit(&r->active, (epoch << 1) | 1, memory_order_relaxed);
+    if (lf_membarrier)
+    {
+        atomic_signal_fence(memory_order_seq_cst);
+    }
+    else
+    {
+        atomic_thread_fence(memory_order_seq_cst);
+    }
+    if (epoch != r->epoch)
+    {
+        lfnode *n = r->limbo[epoch % 3];
+        while (n != NULL)
+        {
+            lfnode *next = n->retired;
+            pool_free(&r->nodes, n);
+            n = next;
+        }
+        r->limbo[epoch % 3] = NULL;
+        r->epoch = epoch;
+    }
+    return r;
+}
+
+// Ends an operation, after which the thread holds no node
+void lf_exit(lfthread *r)
+{
+    atomic_store_explicit(&r->active, 0, memory_order_release);
+}
+
+// Keeps an unlinked node until no thread can reach it any more
+void lf_retire(lftable *t, lfthread *r, lfnode *n)
+{
+    n->retired = r->limbo[r->epoch % 3];
+    r->limbo[r->epoch % 3] = n;
+    if (++r->retired % LF_RECLAIM == 0)
+    {
+        lf_advance(t);
+    }
+}
+
+// Moves the epoch on if every thread inside an operation has announced the current one
+void lf_advance(lftable *t)
+{
+#ifdef __linux__
+    if (lf_membarrier)
+    {
+        syscall(SYS_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0, 0);
+    }
+#endif
+    atomic_thread_fence(memory_order_seq_cst);
+    size_t epoch = atomic_load(&t->epoch);
+    for (int i = 0; i < LF_THREADS; i++)
+    {
+        size_t active = atomic_load(&t->threads[i].active);
+        if ((active & 1) && (active >> 1) != epoch)
+        {
+            return;
+        }
+    }
+    atomic_compare_exchange_strong(&t->epoch, &epoch, epoch + 1);
+}
+
+// Returns the 32 bits in reverse order, which turns a hash into its bucket,
+// and a bucket into the key of its dummy, sorted right before the bucket's
+// numbers and after its parent
+uint32_t lf_reverse(uint32_t bits)
+{
+    bits = ((bits >> 1) & 0x55555555u) | ((bits & 0x55555555u) << 1);
+    bits = ((bits >> 2) & 0x33333333u) | ((bits & 0x33333333u) << 2);
+    bits = ((bits >> 4) & 0x0F0F0F0Fu) | ((bits & 0x0F0F0F0Fu) << 4);
+    bits = ((bits >> 8) & 0x00FF00FFu) | ((bits & 0x00FF00FFu) << 8);
+    return (bits >> 16) | (bits << 16);
+}
+
+// Finds the segment of bucket b and its offset there, and returns the segment's length
+size_t lf_locate(size_t b, int *segment, size_t *offset)
+{
+    if (b < LF_MIN_BUCKETS)
+    {
+        *segment = 0;
+        *offset = b;
+        return LF_MIN_BUCKETS;
+    }
+    int high = 63 - __builtin_clzll(b);
+    *segment = high - LF_SEGMENT_BITS + 1;
+    *offset = b - ((size_t) 1 << high);
+    return (size_t) 1 << high;
+}
+
+// Returns the slot of bucket b, allocating its segment on first use, or NULL if out of memory
+lfbucket *lf_slot(lftable *t, lfthread *r, size_t b)
+{
+    int segment;
+    size_t offset;
+    size_t length = lf_locate(b, &segment, &offset);
+    lfbucket *buckets = atomic_load_explicit(&t->segments[segment], memory_order_acquire);
+    if (buckets == NULL)
+    {
+        // two threads may race to allocate it: the loser frees its copy
+        lfbucket *fresh = mem_calloc(&r->mem, length, sizeof(lfbucket));
+        if (fresh == NULL)
+        {
+            return NULL;
+        }
+        if (atomic_compare_exchange_strong(&t->segments[segment], &buckets, fresh))
+        {
+            buckets = fresh;
+        }
+        else
+        {
+            mem_free(&r->mem, fresh, length * sizeof(lfbucket));
+        }
+    }
+    return &buckets[offset];
+}
+
+// Returns the dummy node of bucket b, linking it into the list after its
+// parent's the first time the bucket is used, or NULL if out of memory
+lfnode *lf_bucket(lftable *t, lfthread *r, size_t b)
+{
+    lfbucket *slot = lf_slot(t, r, b);
+    if (slot == NULL)
+    {
+        return NULL;
+    }
+    lfnode *dummy = atomic_load_explicit(slot, memory_order_acquire);
+    if (dummy != NULL)
+    {
+        return dummy;
+    }
+
+    lfnode *n = pool_alloc(&r->nodes, &r->mem);
+    if (n == NULL)
+    {
+        return NULL;
+    }
+    n->key = (uint64_t) lf_reverse((uint32_t) b) << 1;
+    n->number = 0;
+    atomic_init(&n->next, 0);
+
+    // bucket 0's dummy heads the whole list; any other links in after its parent's
+    lfnode *parent = (b == 0) ? NULL : lf_bucket(t, r, b & ~((size_t) 1 << (63 - __builtin_clzll(b))));
+    if (b == 0)
+    {
+        dummy = n;
+    }
+    else if (parent != NULL)
+    {
+        dummy = lf_link(t, r, parent, n);
+    }
+    if (dummy != n)
+    {
+        pool_free(&r->nodes, n);
+    }
+
+    // threads racing on the same bucket all end up with the same dummy,
+    // except on bucket 0, where the first one published wins
+    lfnode *expected = NULL;
+    if (dummy != NULL && !atomic_compare_exchange_strong(slot, &expected, dummy))
+    {
+        if (dummy == n && b == 0)
+        {
+            pool_free(&r->nodes, n);
+        }
+        dummy = expected;
+    }
+    return dummy;
+}
+
+// Returns the dummy of bucket b or, if b was never used, of its closest
+// ancestor that was, which sorts before b's numbers as well; NULL if the
+// table is empty
+lfnode *lf_nearest(lftable *t, size_t b)
+{
+    for (;;)
+    {
+        int segment;
+        size_t offset;
+        lf_locate(b, &segment, &offset);
+        lfbucket *buckets = atomic_load_explicit(&t->segments[segment], memory_order_acquire);
+        lfnode *dummy = (buckets != NULL) ? atomic_load_explicit(&buckets[offset], memory_order_acquire) : NULL;
+        if (dummy != NULL || b == 0)
+        {
+            return dummy;
+        }
+        b &= ~((size_t) 1 << (63 - __builtin_clzll(b)));
+    }
+}
+
+// Finds where (key, number) belongs in the list after head, unlinking and
+// retiring the deleted nodes it passes, and returns true if it is there
+// prev receives the link pointing at cur, the first node at or after it
+bool lf_find(lftable *t, lfthread *r, lfnode *head, uint64_t key, int number, _Atomic(uintptr_t) **prev,
+             lfnode **cur)
+{
+    bool restart = true;
+    while (restart)
+    {
+        restart = false;
+        *prev = &head->next;
+        *cur = (lfnode *) atomic_load_explicit(*prev, memory_order_acquire);
+        while (*cur != NULL)
+        {
+            uintptr_t next = atomic_load_explicit(&(*cur)->next, memory_order_acquire);
+            if (next & 1)
+            {
+                // deleted: unlink it, or start over if the node before changed
+                uintptr_t expected = (uintptr_t) *cur;
+                if (!atomic_compare_exchange_strong(*prev, &expected, next & ~(uintptr_t) 1))
+                {
+                    restart = true;
+                    break;
+                }
+                lf_retire(t, r, *cur);
+                *cur = (lfnode *) (next & ~(uintptr_t) 1);
+                continue;
+            }
+
+            if ((*cur)->key > key || ((*cur)->key == key && (*cur)->number >= number))
+            {
+                return (*cur)->key == key && (*cur)->number == number;
+            }
+            *prev = &(*cur)->next;
+            *cur = (lfnode *) next;
+        }
+    }
+    return false;
+}
+
+// Links n into the list after head unless an equal node is there already,
+// returning whichever node ends up in the list
+lfnode *lf_link(lftable *t, lfthread *r, lfnode *head, lfnode *n)
+{
+    for (;;)
+    {
+        _Atomic(uintptr_t) *prev;
+        lfnode *cur;
+        if (lf_find(t, r, head, n->key, n->number, &prev, &cur))
+        {
+            return cur;
+        }
+        atomic_store_explicit(&n->next, (uintptr_t) cur, memory_order_relaxed);
+        uintptr_t expected = (uintptr_t) cur;
+        if (atomic_compare_exchange_strong(prev, &expected, (uintptr_t) n))
+        {
+            return n;
+        }
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef LOCKFREE_HASH_H
+#define LOCKFREE_HASH_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hashfunc.h"
+#include "ingest.h"
+#include "memory.h"
+#include "pool.h"
+
+// Buckets of the first segment (as a power of two); segment k > 0 holds
+// the next 2^(LF_SEGMENT_BITS + k - 1) buckets, so the bucket array grows
+// without ever being copied
+#define LF_SEGMENT_BITS 10
+#define LF_MIN_BUCKETS (1 << LF_SEGMENT_BITS)
+#define LF_SEGMENTS (32 - LF_SEGMENT_BITS + 1)
+
+// The table doubles its buckets when it holds more numbers per bucket than this
+#define LF_MAX_LOAD 1.0
+
+// Threads that may use the tables at the same time
+#define LF_THREADS 256
+
+// Nodes a thread retires between attempts to advance the epoch
+#define LF_RECLAIM 128
+
+// Represents a node of the split-ordered list; the lowest bit of next marks
+// the node as deleted
+typedef struct lfnode
+{
+    uint64_t key;
+    _Atomic(uintptr_t) next;
+    int number;
+    // links the node into its thread's retired nodes once it is unlinked
+    struct lfnode *retired;
+} lfnode;
+
+// A lock-free hash table, only handled through the functions below
+typedef struct lftable lftable;
+
+lftable *lf_create(void);
+void lf_destroy(lftable *t);
+bool lf_insert(lftable *t, const char *data_file);
+bool lf_add(lftable *t, int number);
+bool lf_add_batch(lftable *t, const int *keys, size_t n);
+memstats *lf_memory(lftable *t);
+bool lf_search(lftable *t, int numbers);
+bool lf_contains(lftable *t, int number);
+size_t lf_contains_batch(lftable *t, const int *keys, size_t n, bool *found);
+bool lf_remove(lftable *t, int number);
+void lf_unload(lftable *t);
+
+#endif
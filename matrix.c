@@ -0,0 +1,232 @@
+// Matrix runner: every structure against every dataset arrangement
+
+// Each cell runs in a freshly forked child so no structure inherits another
+// one's heap, and so a cell that crashes or runs out of memory only loses
+// its own row. The child sends its timings back through a pipe; the parent
+// collects CPU time and peak resident memory from wait4's rusage.
+// Cells are killed with SIGALRM after a timeout so the O(n) lists can't
+// hold up the whole run
+
+// The sweep reuses the same machinery to run one structure on growing
+// prefixes of a dataset, 1-2-5 log-spaced from 1K keys up to the whole file,
+// so the per-key cost can be plotted against the size of the structure
+
+#define _DEFAULT_SOURCE
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "matrix.h"
+
+// Dataset arrangements, each a file of that name in both directories
+const char *arrangements[] = {"random", "sorted", "reversed", NULL};
+
+// Smallest and largest prefix the sweep runs
+#define SWEEP_FIRST 1000
+#define SWEEP_LAST 10000000
+
+// Function prototypes
+int run_child(const char *structure, const char *data_file, const char *search_file, size_t limit,
+              int timeout, cell_fn run, cell *c, struct rusage *usage, bool *timed_out);
+
+// Runs every cell and prints the comparison table, returning 0 unless a cell failed
+int matrix_run(const char **structures, const char *data_dir, const char *search_dir, int timeout, cell_fn run)
+{
+    printf("\n=== MATRIX %s/ x %s/ (timeout %d s per cell) ===\n", data_dir, search_dir, timeout);
+    printf("%-6s %-9s %11s %11s %11s %11s %11s %10s %10s %12s\n", "STRUCT", "ORDER", "INSERT s", "SEARCH s",
+           "UNLOAD s", "TOTAL s", "CPU s", "NOT FOUND", "BYTES/KEY", "PEAK RSS MB");
+
+    int failures = 0;
+    for (int i = 0; structures[i] != NULL; i++)
+    {
+        for (int j = 0; arrangements[j] != NULL; j++)
+        {
+            char data_file[4096], search_file[4096];
+            snprintf(data_file, sizeof(data_file), "%s/%s.txt", data_dir, arrangements[j]);
+            snprintf(search_file, sizeof(search_file), "%s/%s.txt", search_dir, arrangements[j]);
+
+            cell c;
+            struct rusage usage;
+            bool timed_out = false;
+            int status = run_child(structures[i], data_file, search_file, 0, timeout, run, &c,
+                                   &usage, &timed_out);
+
+            printf("%-6s %-9s ", structures[i], arrangements[j]);
+            if (status == 0)
+            {
+                double total = c.phases[HARNESS_INSERT] + c.phases[HARNESS_SEARCH] + c.phases[HARNESS_UNLOAD];
+                printf("%11.6f %11.6f %11.6f %11.6f ", c.phases[HARNESS_INSERT], c.phases[HARNESS_SEARCH],
+                       c.phases[HARNESS_UNLOAD], total);
+            }
+            else
+            {
+                printf("%-47s ", timed_out ? "timeout" : "failed");
+                failures += timed_out ? 0 : 1;
+            }
+
+            // ru_maxrss is in kilobytes on Linux
+            double cpu = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+                         usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+            printf("%11.6f ", cpu);
+            if (status == 0)
+            {
+                printf("%10zu %10.1f ", c.notFound, c.keys > 0 ? (double) c.bytes / c.keys : 0.0);
+            }
+            else
+            {
+                printf("%10s %10s ", "-", "-");
+            }
+            printf("%12.1f\n", usage.ru_maxrss / 1024.0);
+            fflush(stdout);
+        }
+    }
+    printf("\n");
+
+    return failures == 0 ? 0 : 1;
+}
+
+// Runs every structure on growing prefixes of the dataset and prints ns/op
+// and memory per key for each size, returning 0 unless a run failed
+int matrix_sweep(const char **structures, const char *data_file, const char *search_file, int timeout, cell_fn run)
+{
+    int failures = 0;
+    for (int i = 0; structures[i] != NULL; i++)
+    {
+        printf("\n=== SWEEP %s on %s x %s (timeout %d s per size) ===\n", structures[i], data_file,
+               search_file, timeout);
+        printf("%10s %14s %14s %14s %12s %12s\n", "KEYS", "INSERT ns/op", "SEARCH ns/op", "UNLOAD ns/op",
+               "BYTES/KEY", "PEAK RSS MB");
+
+        // 1, 2, 5, 10, 20, 50... times SWEEP_FIRST
+        size_t steps[] = {1, 2, 5};
+        size_t previous = 0;
+        for (size_t decade = SWEEP_FIRST, step = 0; decade * steps[step] <= SWEEP_LAST;)
+        {
+            size_t limit = decade * steps[step];
+
+            cell c;
+            struct rusage usage;
+            bool timed_out = false;
+            int status = run_child(structures[i], data_file, search_file, limit, timeout, run, &c,
+                                   &usage, &timed_out);
+            if (status != 0)
+            {
+                printf("%10zu %s\n", limit, timed_out ? "timeout, larger sizes skipped" : "failed");
+                failures += timed_out ? 0 : 1;
+                break;
+            }
+
+            // the whole dataset was already used by the previous size
+            if (c.keys == previous)
+            {
+                break;
+            }
+            previous = c.keys;
+
+            printf("%10zu %14.1f %14.1f %14.1f %12.1f %12.1f\n", c.keys,
+                   c.keys > 0 ? c.phases[HARNESS_INSERT] * 1e9 / c.keys : 0.0,
+                   c.queries > 0 ? c.phases[HARNESS_SEARCH] * 1e9 / c.queries : 0.0,
+                   c.keys > 0 ? c.phases[HARNESS_UNLOAD] * 1e9 / c.keys : 0.0,
+                   c.keys > 0 ? (double) c.bytes / c.keys : 0.0, usage.ru_maxrss / 1024.0);
+            fflush(stdout);
+
+            // the whole dataset has been used
+            if (c.keys < limit)
+            {
+                break;
+            }
+
+            if (++step == 3)
+            {
+                step = 0;
+                decade *= 10;
+            }
+        }
+    }
+    printf("\n");
+
+    return failures == 0 ? 0 : 1;
+}
+
+// Forks a child to run one cell, returning 0 if it sent its results back
+int run_child(const char *structure, const char *data_file, const char *search_file, size_t limit,
+              int timeout, cell_fn run, cell *c, struct rusage *usage, bool *timed_out)
+{
+    memset(usage, 0, sizeof(struct rusage));
+
+    int fds[2];
+    if (pipe(fds) == -1)
+    {
+        return -1;
+    }
+
+    // anything still buffered would otherwise be printed twice
+    fflush(stdout);
+
+    pid_t pid = fork();
+    if (pid == -1)
+    {
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+
+    if (pid == 0)
+    {
+        close(fds[0]);
+
+        // keep the structures' own messages out of the table
+        int null = open("/dev/null", O_WRONLY);
+        if (null != -1)
+        {
+            dup2(null, STDOUT_FILENO);
+            close(null);
+        }
+
+        // the default action of SIGALRM terminates the child
+        alarm(timeout);
+
+        cell result;
+        bool done = run(structure, data_file, search_file, limit, &result);
+        if (done && write(fds[1], &result, sizeof(result)) != sizeof(result))
+        {
+            done = false;
+        }
+        _exit(done ? 0 : 1);
+    }
+
+    close(fds[1]);
+
+    // a child that dies early closes the pipe and the read comes back short
+    ssize_t got = 0;
+    while (got < (ssize_t) sizeof(cell))
+    {
+        ssize_t n = read(fds[0], (char *) c + got, sizeof(cell) - got);
+        if (n <= 0)
+        {
+            break;
+        }
+        got += n;
+    }
+    close(fds[0]);
+
+    int status;
+    if (wait4(pid, &status, 0, usage) == -1)
+    {
+        return -1;
+    }
+
+    *timed_out = WIFSIGNALED(status) && WTERMSIG(status) == SIGALRM;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || got != sizeof(cell))
+    {
+        return -1;
+    }
+    return 0;
+}
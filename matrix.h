@@ -0,0 +1,27 @@
+#ifndef MATRIX_H
+#define MATRIX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "harness.h"
+
+// Results of one benchmark run, sent back by the child process
+typedef struct cell
+{
+    double phases[HARNESS_PHASES];
+    size_t keys;
+    size_t queries;
+    size_t notFound;
+    size_t bytes;
+} cell;
+
+// Runs one structure against one dataset and search file, or against
+// their first limit numbers if limit isn't 0
+typedef bool (*cell_fn)(const char *structure, const char *data_file, const char *search_file,
+                        size_t limit, cell *c);
+
+int matrix_run(const char **structures, const char *data_dir, const char *search_dir, int timeout, cell_fn run);
+int matrix_sweep(const char **structures, const char *data_file, const char *search_file, int timeout, cell_fn run);
+
+#endif
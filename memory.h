@@ -0,0 +1,90 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Allocation counters kept by every structure
+// Counting requested bytes rather than asking the allocator keeps the
+// overhead to a few additions per node, and gives the same numbers
+// whatever malloc the benchmark is linked against
+typedef struct memstats
+{
+    size_t live;
+    size_t peak;
+    size_t fixed;
+    size_t allocations;
+    size_t frees;
+} memstats;
+
+// Clears the counters, keeping the static storage the structure owns
+static inline void mem_reset(memstats *m)
+{
+    size_t fixed = m->fixed;
+    memset(m, 0, sizeof(memstats));
+    m->fixed = fixed;
+    m->peak = fixed;
+}
+
+// Records static storage (e.g. a fixed-size bucket array) owned by the structure
+static inline void mem_fixed(memstats *m, size_t bytes)
+{
+    m->fixed = bytes;
+    if (m->live + m->fixed > m->peak)
+    {
+        m->peak = m->live + m->fixed;
+    }
+}
+
+// Counts an allocation of size bytes
+static inline void mem_count(memstats *m, size_t size)
+{
+    m->live += size;
+    m->allocations++;
+    if (m->live + m->fixed > m->peak)
+    {
+        m->peak = m->live + m->fixed;
+    }
+}
+
+// malloc, counted against m
+static inline void *mem_alloc(memstats *m, size_t size)
+{
+    void *p = malloc(size);
+    if (p != NULL)
+    {
+        mem_count(m, size);
+    }
+    return p;
+}
+
+// calloc, counted against m
+static inline void *mem_calloc(memstats *m, size_t count, size_t size)
+{
+    void *p = calloc(count, size);
+    if (p != NULL)
+    {
+        mem_count(m, count * size);
+    }
+    return p;
+}
+
+// free of a block of size bytes allocated through m
+static inline void mem_free(memstats *m, void *p, size_t size)
+{
+    if (p != NULL)
+    {
+        m->live -= size;
+        m->frees++;
+        free(p);
+    }
+}
+
+// Total bytes the structure holds right now
+static inline size_t mem_total(const memstats *m)
+{
+    return m->live + m->fixed;
+}
+
+#endif
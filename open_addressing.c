@@ -0,0 +1,295 @@
+// Open addressing hash table that loads a dataset, searches and deletes specific values,
+// and finally deletes the remainder of the dataset from memory
+
+// Keys are stored inline in one flat array of ints, so an insert costs no
+// malloc and a lookup touches one or two cache lines. Collisions probe the
+// next slots (linear probing), and deletion shifts the rest of the run back
+// into the hole instead of leaving a tombstone, so probe runs never grow
+// because of deletes
+
+// 0 marks an empty slot, which lets the array come zeroed from calloc;
+// the key 0 itself is kept in a flag next to the array
+
+// Like the AVL tree, the table holds each number once
+
+#include "open_addressing.h"
+
+// Everything one table owns
+struct oatable
+{
+    int *slots;
+    size_t capacity;
+    size_t count;
+    bool zero;
+    memstats mem;
+};
+
+// How many lookups a batch runs side by side, and how far ahead batched inserts prefetch
+#define OA_GROUP 16
+#define OA_PREFETCH 8
+
+// Function prototypes
+bool oa_ingest(void *t, int number);
+size_t oa_home(const oatable *t, int number);
+bool oa_resize(oatable *t, size_t capacity);
+void oa_place(int *slots, size_t mask, size_t home, int number);
+
+// Global variables
+double oa_max_load = OA_MAX_LOAD;
+
+// Creates an empty table, returning NULL if out of memory
+// The slot array is allocated with the first number
+oatable *oa_create(void)
+{
+    return calloc(1, sizeof(oatable));
+}
+
+// Frees the table and every number left in it
+void oa_destroy(oatable *t)
+{
+    if (t != NULL)
+    {
+        oa_unload(t);
+        free(t);
+    }
+}
+
+// Sets the share of slots every table may fill before doubling,
+// returning false if it is out of range
+bool oa_load(double load)
+{
+    if (load < 0.1 || load > 0.99)
+    {
+        return false;
+    }
+    oa_max_load = load;
+    return true;
+}
+
+// Loads database into memory, returning true if successful, else false
+bool oa_insert(oatable *t, const char *data_file)
+{
+    mem_reset(&t->mem);
+
+    if (!ingest(data_file, oa_ingest, t))
+    {
+        oa_unload(t);
+        return false;
+    }
+    return true;
+}
+
+// Adds a single number to the table, returning false if out of memory
+bool oa_add(oatable *t, int number)
+{
+    if (number == 0)
+    {
+        t->count += !t->zero;
+        t->zero = true;
+        return true;
+    }
+
+    // a number already there takes no room, so it must not grow the table
+    if (oa_contains(t, number))
+    {
+        return true;
+    }
+
+    // grow before the table gets too full for short probes
+    if (t->slots == NULL || t->count + 1 > t->capacity * oa_max_load)
+    {
+        if (!oa_resize(t, (t->slots == NULL) ? OA_MIN_CAPACITY : t->capacity * 2))
+        {
+            return false;
+        }
+    }
+
+    oa_place(t->slots, t->capacity - 1, oa_home(t, number), number);
+    t->count++;
+    return true;
+}
+
+// Adds n numbers, returning false if out of memory
+// The home slot of the key OA_PREFETCH places ahead is prefetched while
+// the current key is placed
+bool oa_add_batch(oatable *t, const int *keys, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        if (i + OA_PREFETCH < n && t->slots != NULL)
+        {
+            __builtin_prefetch(&t->slots[oa_home(t, keys[i + OA_PREFETCH])], 1);
+        }
+        if (!oa_add(t, keys[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// oa_add in the shape ingest calls it
+bool oa_ingest(void *t, int number)
+{
+    return oa_add(t, number);
+}
+
+// Returns the allocation counters of the table
+memstats *oa_memory(oatable *t)
+{
+    return &t->mem;
+}
+
+// Searches for a number and deletes it if found, the benchmark's fused operation
+bool oa_search(oatable *t, int numbers)
+{
+    return oa_remove(t, numbers);
+}
+
+// Returns true if number is in the table, leaving the table untouched
+bool oa_contains(oatable *t, int number)
+{
+    if (number == 0 || t->slots == NULL)
+    {
+        return number == 0 && t->zero;
+    }
+
+    // a run always ends in an empty slot, since the table is never full
+    size_t mask = t->capacity - 1;
+    for (size_t i = oa_home(t, number); t->slots[i] != 0; i = (i + 1) & mask)
+    {
+        if (t->slots[i] == number)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Looks up n numbers, setting found[i] for each, and returns how many were found
+// The home slots of a group of OA_GROUP keys are prefetched before any of
+// them is probed, so their cache misses overlap
+size_t oa_contains_batch(oatable *t, const int *keys, size_t n, bool *found)
+{
+    size_t hits = 0;
+    for (size_t base = 0; base < n; base += OA_GROUP)
+    {
+        size_t group = (n - base < OA_GROUP) ? n - base : OA_GROUP;
+        if (t->slots != NULL)
+        {
+            for (size_t j = 0; j < group; j++)
+            {
+                __builtin_prefetch(&t->slots[oa_home(t, keys[base + j])]);
+            }
+        }
+        for (size_t j = 0; j < group; j++)
+        {
+            found[base + j] = oa_contains(t, keys[base + j]);
+            hits += found[base + j];
+        }
+    }
+    return hits;
+}
+
+// Deletes number from the table, returning false if it wasn't there
+bool oa_remove(oatable *t, int number)
+{
+    if (number == 0 || t->slots == NULL)
+    {
+        if (number != 0 || !t->zero)
+        {
+            return false;
+        }
+        t->zero = false;
+        t->count--;
+        return true;
+    }
+
+    size_t mask = t->capacity - 1;
+    size_t hole = oa_home(t, number);
+    while (t->slots[hole] != number)
+    {
+        if (t->slots[hole] == 0)
+        {
+            return false;
+        }
+        hole = (hole + 1) & mask;
+    }
+
+    // backward shift: pull every later key of the run that may sit in the
+    // hole back into it, until the run ends
+    for (size_t i = (hole + 1) & mask; t->slots[i] != 0; i = (i + 1) & mask)
+    {
+        // a key can move back unless its home lies between the hole and its slot
+        size_t home = oa_home(t, t->slots[i]);
+        if (((i - home) & mask) >= ((i - hole) & mask))
+        {
+            t->slots[hole] = t->slots[i];
+            hole = i;
+        }
+    }
+    t->slots[hole] = 0;
+    t->count--;
+    return true;
+}
+
+// Frees the slot array, leaving an empty table
+void oa_unload(oatable *t)
+{
+    if (t->slots != NULL)
+    {
+        mem_free(&t->mem, t->slots, t->capacity * sizeof(int));
+    }
+    t->slots = NULL;
+    t->capacity = 0;
+    t->count = 0;
+    t->zero = false;
+}
+
+// Home slot of a number: the top bits of number * 2^32 / Phi (golden number),
+// which spreads consecutive numbers over the whole table
+size_t oa_home(const oatable *t, int number)
+{
+    uint64_t product = (uint64_t) ((uint32_t) number * 2654435761u);
+    return (size_t) ((product * t->capacity) >> 32);
+}
+
+// Moves every number into a new array of capacity slots, returning false if out of memory
+bool oa_resize(oatable *t, size_t capacity)
+{
+    int *slots = mem_calloc(&t->mem, capacity, sizeof(int));
+    if (slots == NULL)
+    {
+        return false;
+    }
+
+    int *old = t->slots;
+    size_t oldCapacity = t->capacity;
+    t->slots = slots;
+    t->capacity = capacity;
+
+    for (size_t i = 0; i < oldCapacity; i++)
+    {
+        if (old[i] != 0)
+        {
+            oa_place(slots, capacity - 1, oa_home(t, old[i]), old[i]);
+        }
+    }
+
+    if (old != NULL)
+    {
+        mem_free(&t->mem, old, oldCapacity * sizeof(int));
+    }
+    return true;
+}
+
+// Puts a number known not to be in the table into the first free slot from home
+void oa_place(int *slots, size_t mask, size_t home, int number)
+{
+    size_t i = home;
+    while (slots[i] != 0)
+    {
+        i = (i + 1) & mask;
+    }
+    slots[i] = number;
+}
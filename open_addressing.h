@@ -0,0 +1,34 @@
+#ifndef OPEN_ADDRESSING_H
+#define OPEN_ADDRESSING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ingest.h"
+#include "memory.h"
+
+// Smallest table, in slots (a power of two)
+#define OA_MIN_CAPACITY 1024
+
+// Default share of slots used before the table doubles
+#define OA_MAX_LOAD 0.7
+
+// An open addressing hash table, only handled through the functions below
+typedef struct oatable oatable;
+
+oatable *oa_create(void);
+void oa_destroy(oatable *t);
+bool oa_load(double load);
+bool oa_insert(oatable *t, const char *data_file);
+bool oa_add(oatable *t, int number);
+bool oa_add_batch(oatable *t, const int *keys, size_t n);
+memstats *oa_memory(oatable *t);
+bool oa_search(oatable *t, int numbers);
+bool oa_contains(oatable *t, int number);
+size_t oa_contains_batch(oatable *t, const int *keys, size_t n, bool *found);
+bool oa_remove(oatable *t, int number);
+void oa_unload(oatable *t);
+
+#endif
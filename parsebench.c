@@ -0,0 +1,162 @@
+// Microbenchmark for the text dataset parsers
+// Compares the fscanf("%i") loop the loaders used to run against every
+// parser in parser.c that this CPU supports, reporting throughput in GB/s
+// Usage ./parsebench [dataset/file.txt]
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "parser.h"
+#include "reader.h"
+
+// Default dataset
+#define DATABASE "dataset/random.txt"
+
+// Every parser is timed this many times and the best run is kept
+#define REPETITIONS 5
+
+// Function prototypes
+double now(void);
+double run_fscanf(const char *filename, long long *sum, size_t *count);
+double run_parser(const char *filename, long long *sum, size_t *count);
+void report(const char *name, double seconds, size_t bytes, long long sum, size_t count);
+
+int main(int argc, char *argv[])
+{
+    if (argc > 2)
+    {
+        printf("Usage: ./parsebench [dataset/file]\n");
+        return 1;
+    }
+    const char *data = (argc == 2) ? argv[1] : DATABASE;
+
+    // the size of the file is what the throughput is measured against
+    reader r;
+    if (!reader_open(&r, data))
+    {
+        printf("Could not open %s.\n", data);
+        return 1;
+    }
+    size_t bytes = r.size;
+    bool binary = r.binary;
+    reader_close(&r);
+
+    if (binary)
+    {
+        printf("%s is a binary dataset, there is nothing to parse.\n", data);
+        return 1;
+    }
+
+    printf("\n=== PARSING %s (%zu bytes) ===\n", data, bytes);
+
+    long long sum;
+    size_t count;
+    double seconds = run_fscanf(data, &sum, &count);
+    if (seconds < 0)
+    {
+        printf("Could not open %s.\n", data);
+        return 1;
+    }
+    report("fscanf", seconds, bytes, sum, count);
+
+    int kinds[] = {PARSER_SCALAR, PARSER_SSE41, PARSER_AVX2};
+    for (int i = 0; i < 3; i++)
+    {
+        if (!parser_select(kinds[i]))
+        {
+            continue;
+        }
+        report(parser_name(), run_parser(data, &sum, &count), bytes, sum, count);
+    }
+    printf("\n");
+
+    return 0;
+}
+
+// Returns a monotonic timestamp in seconds
+double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Times the original stdio loop, returning the best run in seconds
+double run_fscanf(const char *filename, long long *sum, size_t *count)
+{
+    double best = -1;
+    for (int rep = 0; rep < REPETITIONS; rep++)
+    {
+        FILE *inptr = fopen(filename, "r");
+        if (inptr == NULL)
+        {
+            return -1;
+        }
+
+        *sum = 0;
+        *count = 0;
+        int buffer;
+
+        double start = now();
+        while (fscanf(inptr, "%i", &buffer) == 1)
+        {
+            *sum += buffer;
+            (*count)++;
+        }
+        double elapsed = now() - start;
+        fclose(inptr);
+
+        if (best < 0 || elapsed < best)
+        {
+            best = elapsed;
+        }
+    }
+    return best;
+}
+
+// Times the reader with the selected parser, returning the best run in seconds
+double run_parser(const char *filename, long long *sum, size_t *count)
+{
+    double best = -1;
+    for (int rep = 0; rep < REPETITIONS; rep++)
+    {
+        reader r;
+        if (!reader_open(&r, filename))
+        {
+            return -1;
+        }
+
+        *sum = 0;
+        *count = 0;
+        int numbers[4096];
+
+        double start = now();
+        size_t n;
+        while ((n = reader_fill(&r, numbers, 4096)) > 0)
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                *sum += numbers[i];
+            }
+            *count += n;
+        }
+        double elapsed = now() - start;
+        reader_close(&r);
+
+        if (best < 0 || elapsed < best)
+        {
+            best = elapsed;
+        }
+    }
+    return best;
+}
+
+// Prints one line of results; the checksum shows every parser agrees
+void report(const char *name, double seconds, size_t bytes, long long sum, size_t count)
+{
+    printf("%-8s %10zu numbers  %10.6f s  %8.3f GB/s  checksum %lld\n",
+           name, count, seconds, bytes / seconds / 1e9, sum);
+}
@@ -0,0 +1,302 @@
+// Decimal number parsers for newline-delimited text datasets
+
+// The scalar parser understands everything the reader accepts: whitespace,
+// an optional sign and decimal digits, wrapping like unsigned arithmetic
+// on overflow. The SSE4.1 and AVX2 parsers convert the common case of a
+// plain number of up to 10 digits followed by a newline with vector
+// instructions and hand anything else back to the scalar parser, so all
+// three always produce the same numbers
+
+// The fastest parser the CPU supports is picked with CPUID on first use
+
+#include <stdint.h>
+
+#include "parser.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PARSER_X86
+#endif
+
+typedef size_t (*parse_fn)(const char **cursor, const char *end, int *numbers, size_t max);
+
+// Function prototypes
+size_t parse_scalar(const char **cursor, const char *end, int *numbers, size_t max);
+#ifdef PARSER_X86
+size_t parse_sse41(const char **cursor, const char *end, int *numbers, size_t max);
+size_t parse_avx2(const char **cursor, const char *end, int *numbers, size_t max);
+#endif
+
+// Global variables
+parse_fn parse_active = NULL;
+int parse_kind = PARSER_SCALAR;
+
+// pshufb masks that right-align the first 'len' bytes of a 16 byte chunk,
+// filling the front with zero digits
+unsigned char parse_shuffle[17][16];
+
+// Picks the parser used by parse_numbers, returning false if the CPU can't run it
+bool parser_select(int kind)
+{
+#ifdef PARSER_X86
+    __builtin_cpu_init();
+    bool sse41 = __builtin_cpu_supports("sse4.1");
+    bool avx2 = sse41 && __builtin_cpu_supports("avx2");
+
+    for (int len = 0; len <= 16; len++)
+    {
+        for (int i = 0; i < 16; i++)
+        {
+            parse_shuffle[len][i] = (i >= 16 - len) ? i - (16 - len) : 0x80;
+        }
+    }
+
+    if (kind == PARSER_AUTO)
+    {
+        kind = avx2 ? PARSER_AVX2 : sse41 ? PARSER_SSE41 : PARSER_SCALAR;
+    }
+
+    if (kind == PARSER_AVX2 && avx2)
+    {
+        parse_active = parse_avx2;
+        parse_kind = kind;
+        return true;
+    }
+    if (kind == PARSER_SSE41 && sse41)
+    {
+        parse_active = parse_sse41;
+        parse_kind = kind;
+        return true;
+    }
+#endif
+
+    if (kind == PARSER_AUTO || kind == PARSER_SCALAR)
+    {
+        parse_active = parse_scalar;
+        parse_kind = PARSER_SCALAR;
+        return true;
+    }
+    return false;
+}
+
+// Returns the name of the parser in use
+const char *parser_name(void)
+{
+    if (parse_active == NULL)
+    {
+        parser_select(PARSER_AUTO);
+    }
+
+    switch (parse_kind)
+    {
+        case PARSER_AVX2:
+            return "avx2";
+        case PARSER_SSE41:
+            return "sse4.1";
+        default:
+            return "scalar";
+    }
+}
+
+// Parses up to max numbers starting at *cursor, returning how many were read
+size_t parse_numbers(const char **cursor, const char *end, int *numbers, size_t max)
+{
+    if (parse_active == NULL)
+    {
+        parser_select(PARSER_AUTO);
+    }
+    return parse_active(cursor, end, numbers, max);
+}
+
+// Parses a single number, returning false at the end of the data
+bool parse_one(const char **cursor, const char *end, int *number)
+{
+    const char *p = *cursor;
+
+    // skip the newline (or any other whitespace) before the number
+    while (p < end && (*p == '\n' || *p == ' ' || *p == '\r' || *p == '\t'))
+    {
+        p++;
+    }
+
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        negative = (*p == '-');
+        p++;
+    }
+
+    // unsigned so overflowing values wrap instead of being undefined
+    unsigned int value = 0;
+    const char *digits = p;
+    while (p < end && *p >= '0' && *p <= '9')
+    {
+        value = value * 10 + (unsigned int) (*p - '0');
+        p++;
+    }
+
+    *cursor = p;
+
+    // nothing left to read, or something that isn't a number
+    if (p == digits)
+    {
+        return false;
+    }
+
+    *number = (int) (negative ? 0u - value : value);
+    return true;
+}
+
+// Portable parser, one digit at a time
+size_t parse_scalar(const char **cursor, const char *end, int *numbers, size_t max)
+{
+    size_t count = 0;
+    while (count < max && parse_one(cursor, end, &numbers[count]))
+    {
+        count++;
+    }
+    return count;
+}
+
+#ifdef PARSER_X86
+
+// Parses one number per 16 byte load
+__attribute__((target("sse4.1")))
+size_t parse_sse41(const char **cursor, const char *end, int *numbers, size_t max)
+{
+    const __m128i zero = _mm_set1_epi8('0');
+    const __m128i nine = _mm_set1_epi8(9);
+    const __m128i tens = _mm_setr_epi8(10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1);
+    const __m128i hundreds = _mm_setr_epi16(100, 1, 100, 1, 100, 1, 100, 1);
+    const __m128i myriads = _mm_setr_epi16(10000, 1, 10000, 1, 10000, 1, 10000, 1);
+
+    const char *p = *cursor;
+    size_t count = 0;
+    while (count < max)
+    {
+        // the load must stay inside the mapping
+        if (end - p >= 16 && *p >= '0' && *p <= '9')
+        {
+            __m128i chunk = _mm_sub_epi8(_mm_loadu_si128((const __m128i *) p), zero);
+
+            // digits are the bytes that are still 0-9 once '0' is subtracted
+            __m128i digits = _mm_cmpeq_epi8(_mm_min_epu8(chunk, nine), chunk);
+            unsigned int mask = (unsigned int) _mm_movemask_epi8(digits);
+            int len = __builtin_ctz(~mask);
+
+            if (len <= 10)
+            {
+                // right-align the digits, then fold pairs of them together:
+                // 16 digits -> 8 x 2 digits -> 4 x 4 digits -> 2 x 8 digits
+                chunk = _mm_shuffle_epi8(chunk, _mm_loadu_si128((const __m128i *) parse_shuffle[len]));
+                chunk = _mm_maddubs_epi16(chunk, tens);
+                chunk = _mm_madd_epi16(chunk, hundreds);
+                chunk = _mm_packus_epi32(chunk, chunk);
+                chunk = _mm_madd_epi16(chunk, myriads);
+
+                uint64_t high = (uint32_t) _mm_cvtsi128_si32(chunk);
+                uint64_t low = (uint32_t) _mm_extract_epi32(chunk, 1);
+                numbers[count++] = (int) (uint32_t) (high * 100000000 + low);
+
+                // step over the newline so the next number starts on a digit
+                p += len;
+                if (p < end && *p == '\n')
+                {
+                    p++;
+                }
+                continue;
+            }
+        }
+
+        // signs, stray whitespace, overlong numbers and the tail of the file
+        if (!parse_one(&p, end, &numbers[count]))
+        {
+            break;
+        }
+        count++;
+    }
+
+    *cursor = p;
+    return count;
+}
+
+// Parses two numbers per iteration, one in each 128 bit lane
+__attribute__((target("avx2")))
+size_t parse_avx2(const char **cursor, const char *end, int *numbers, size_t max)
+{
+    const __m256i zero = _mm256_set1_epi8('0');
+    const __m256i nine = _mm256_set1_epi8(9);
+    const __m256i tens = _mm256_setr_epi8(10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1,
+                                          10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1);
+    const __m256i hundreds = _mm256_setr_epi16(100, 1, 100, 1, 100, 1, 100, 1,
+                                               100, 1, 100, 1, 100, 1, 100, 1);
+    const __m256i myriads = _mm256_setr_epi16(10000, 1, 10000, 1, 10000, 1, 10000, 1,
+                                              10000, 1, 10000, 1, 10000, 1, 10000, 1);
+
+    const char *p = *cursor;
+    size_t count = 0;
+    while (count + 2 <= max)
+    {
+        // both numbers must sit in the first 32 bytes, and the second
+        // number's 16 byte load must stay inside the mapping
+        if (end - p >= 48 && *p >= '0' && *p <= '9')
+        {
+            __m256i block = _mm256_sub_epi8(_mm256_loadu_si256((const __m256i *) p), zero);
+            __m256i digits = _mm256_cmpeq_epi8(_mm256_min_epu8(block, nine), block);
+            unsigned int mask = (unsigned int) _mm256_movemask_epi8(digits);
+
+            unsigned int first = (mask != 0xFFFFFFFF) ? __builtin_ctz(~mask) : 32;
+            if (first <= 10 && p[first] == '\n')
+            {
+                const char *q = p + first + 1;
+                unsigned int rest = ~mask >> (first + 1);
+                unsigned int second = (rest != 0) ? __builtin_ctz(rest) : 32;
+
+                if (second >= 1 && second <= 10)
+                {
+                    __m256i pair = _mm256_inserti128_si256(
+                        _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) p)),
+                        _mm_loadu_si128((const __m128i *) q), 1);
+                    __m256i shuffle = _mm256_inserti128_si256(
+                        _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) parse_shuffle[first])),
+                        _mm_loadu_si128((const __m128i *) parse_shuffle[second]), 1);
+
+                    // same folding as the SSE4.1 parser, once per lane
+                    pair = _mm256_shuffle_epi8(_mm256_sub_epi8(pair, zero), shuffle);
+                    pair = _mm256_maddubs_epi16(pair, tens);
+                    pair = _mm256_madd_epi16(pair, hundreds);
+                    pair = _mm256_packus_epi32(pair, pair);
+                    pair = _mm256_madd_epi16(pair, myriads);
+
+                    uint64_t high = (uint32_t) _mm256_extract_epi32(pair, 0);
+                    uint64_t low = (uint32_t) _mm256_extract_epi32(pair, 1);
+                    numbers[count++] = (int) (uint32_t) (high * 100000000 + low);
+
+                    high = (uint32_t) _mm256_extract_epi32(pair, 4);
+                    low = (uint32_t) _mm256_extract_epi32(pair, 5);
+                    numbers[count++] = (int) (uint32_t) (high * 100000000 + low);
+
+                    p = q + second;
+                    if (*p == '\n')
+                    {
+                        p++;
+                    }
+                    continue;
+                }
+            }
+        }
+
+        if (!parse_one(&p, end, &numbers[count]))
+        {
+            *cursor = p;
+            return count;
+        }
+        count++;
+    }
+
+    // an odd slot left over goes through the single-lane parser
+    *cursor = p;
+    return count + parse_sse41(cursor, end, numbers + count, max - count);
+}
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef PARSER_H
+#define PARSER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Parsers for newline-delimited text datasets
+#define PARSER_AUTO 0
+#define PARSER_SCALAR 1
+#define PARSER_SSE41 2
+#define PARSER_AVX2 3
+
+bool parser_select(int kind);
+const char *parser_name(void);
+size_t parse_numbers(const char **cursor, const char *end, int *numbers, size_t max);
+bool parse_one(const char **cursor, const char *end, int *number);
+
+#endif
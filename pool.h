@@ -0,0 +1,114 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "memory.h"
+
+// Objects of one size carved out of large slabs
+// Allocating is a pointer bump (or popping the free list) instead of a
+// malloc call, consecutive objects sit next to each other in memory, and
+// freeing the whole pool releases a handful of slabs instead of every
+// object one by one. Only the slabs are counted in the memstats
+
+// Bytes of the first slab; every slab is twice the last, up to POOL_SLAB_MAX
+#define POOL_SLAB_MIN 4096
+#define POOL_SLAB_MAX (1 << 20)
+
+// Head of every slab, linking it to the one allocated before
+typedef struct slab
+{
+    struct slab *next;
+    size_t bytes;
+    // keeps the objects after it aligned for any type
+    max_align_t align[];
+} slab;
+
+// A pool of objects of one size, with the objects freed so far linked
+// through their first bytes
+typedef struct pool
+{
+    size_t size;
+    size_t slabBytes;
+    slab *slabs;
+    char *next;
+    char *end;
+    void *freeList;
+} pool;
+
+// Prepares an empty pool of objects of size bytes
+static inline void pool_init(pool *p, size_t size)
+{
+    memset(p, 0, sizeof(pool));
+
+    // every object must be able to hold the free list link, and stay aligned
+    size = (size < sizeof(void *)) ? sizeof(void *) : size;
+    p->size = (size + sizeof(void *) - 1) / sizeof(void *) * sizeof(void *);
+    p->slabBytes = POOL_SLAB_MIN / 2;
+}
+
+// Adds a slab twice the size of the last, returning false if out of memory
+static inline bool pool_grow(pool *p, memstats *m)
+{
+    size_t bytes = (p->slabBytes < POOL_SLAB_MAX) ? p->slabBytes * 2 : POOL_SLAB_MAX;
+    if (bytes < sizeof(slab) + p->size)
+    {
+        bytes = sizeof(slab) + p->size;
+    }
+
+    slab *s = mem_alloc(m, bytes);
+    if (s == NULL)
+    {
+        return false;
+    }
+    s->next = p->slabs;
+    s->bytes = bytes;
+    p->slabs = s;
+    p->slabBytes = bytes;
+    p->next = (char *) s->align;
+    p->end = (char *) s + bytes;
+    return true;
+}
+
+// Returns an uninitialised object, reusing a freed one first, or NULL if out of memory
+static inline void *pool_alloc(pool *p, memstats *m)
+{
+    if (p->freeList != NULL)
+    {
+        void *object = p->freeList;
+        memcpy(&p->freeList, object, sizeof(void *));
+        return object;
+    }
+
+    if ((size_t) (p->end - p->next) < p->size && !pool_grow(p, m))
+    {
+        return NULL;
+    }
+    void *object = p->next;
+    p->next += p->size;
+    return object;
+}
+
+// Returns an object to the pool for the next pool_alloc
+static inline void pool_free(pool *p, void *object)
+{
+    memcpy(object, &p->freeList, sizeof(void *));
+    p->freeList = object;
+}
+
+// Frees every slab at once, and with them every object of the pool
+static inline void pool_release(pool *p, memstats *m)
+{
+    while (p->slabs != NULL)
+    {
+        slab *next = p->slabs->next;
+        mem_free(m, p->slabs, p->slabs->bytes);
+        p->slabs = next;
+    }
+    pool_init(p, p->size);
+}
+
+#endif
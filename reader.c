@@ -0,0 +1,251 @@
+// Dataset reader shared by every structure loader
+// Maps the whole file into memory and decodes it without going through stdio,
+// so the insertion benchmarks measure the structures and not stdio
+
+// Text files hold one number per line and are decoded by the fastest parser
+// the CPU supports (see parser.c), a batch of numbers at a time
+// Binary datasets (see dataset.h) are recognised by their header and their
+// keys are handed out straight from the mapping without any parsing
+
+#define _DEFAULT_SOURCE
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "dataset.h"
+#include "parser.h"
+#include "reader.h"
+
+// Function prototypes
+bool reader_header(reader *r);
+
+// Maps data_file into memory, returning true if successful, else false
+bool reader_open(reader *r, const char *data_file)
+{
+    r->data = NULL;
+    r->cursor = NULL;
+    r->end = NULL;
+    r->size = 0;
+    r->binary = false;
+    r->count = 0;
+    r->order = DATASET_UNSORTED;
+    r->next = 0;
+    r->filled = 0;
+
+    int fd = open(data_file, O_RDONLY);
+    if (fd == -1)
+    {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1)
+    {
+        close(fd);
+        return false;
+    }
+
+    // an empty file is a valid, empty dataset but can't be mapped
+    if (st.st_size == 0)
+    {
+        close(fd);
+        return true;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // the mapping keeps its own reference to the file
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        return false;
+    }
+
+    // the file is read front to back exactly once
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+    r->data = map;
+    r->cursor = map;
+    r->end = r->data + st.st_size;
+    r->size = st.st_size;
+
+    // binary datasets start with a magic number no text file can start with
+    if (r->size >= DATASET_MAGIC_SIZE && memcmp(r->data, DATASET_MAGIC, DATASET_MAGIC_SIZE) == 0)
+    {
+        if (!reader_header(r))
+        {
+            reader_close(r);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Validates the header of a binary dataset and points the cursor at its keys
+bool reader_header(reader *r)
+{
+    if (r->size < DATASET_HEADER_SIZE)
+    {
+        return false;
+    }
+
+    const unsigned char *header = (const unsigned char *) r->data;
+    uint64_t count = dataset_get64(header + 8);
+    uint32_t width = dataset_get32(header + 16);
+    uint32_t order = dataset_get32(header + 20);
+
+    // keys are read back as int
+    if (width != sizeof(int))
+    {
+        return false;
+    }
+
+    // the file must actually hold every key the header promises
+    if (count > (r->size - DATASET_HEADER_SIZE) / width)
+    {
+        return false;
+    }
+
+    r->binary = true;
+    r->count = count;
+    r->order = order;
+    r->cursor = r->data + DATASET_HEADER_SIZE;
+    r->end = r->cursor + count * width;
+    return true;
+}
+
+// Hands out the next number into *number, returning false at the end of the data
+bool reader_next(reader *r, int *number)
+{
+    // parse a new batch once the previous one runs out
+    if (r->next == r->filled)
+    {
+        r->filled = reader_fill(r, r->batch, READER_BATCH);
+        r->next = 0;
+        if (r->filled == 0)
+        {
+            return false;
+        }
+    }
+
+    *number = r->batch[r->next++];
+    return true;
+}
+
+// Reads up to max numbers into the numbers array, returning how many were read
+size_t reader_fill(reader *r, int *numbers, size_t max)
+{
+    if (!r->binary)
+    {
+        return parse_numbers(&r->cursor, r->end, numbers, max);
+    }
+
+    size_t count = (size_t) (r->end - r->cursor) / sizeof(int);
+    if (count > max)
+    {
+        count = max;
+    }
+
+    const unsigned char *keys = (const unsigned char *) r->cursor;
+    for (size_t i = 0; i < count; i++)
+    {
+        numbers[i] = (int) dataset_get32(keys + i * sizeof(int));
+    }
+    r->cursor += count * sizeof(int);
+    return count;
+}
+
+// Returns how many numbers the data left to read holds: binary datasets
+// say so in their header, text files are counted by their lines without
+// being parsed
+size_t reader_count(const reader *r)
+{
+    if (r->binary)
+    {
+        return (size_t) (r->end - r->cursor) / sizeof(int);
+    }
+
+    size_t lines = 0;
+    const char *p = r->cursor;
+    while (p < r->end)
+    {
+        const char *newline = memchr(p, '\n', r->end - p);
+        lines++;
+        if (newline == NULL)
+        {
+            break;
+        }
+        p = newline + 1;
+    }
+    return lines;
+}
+
+// Reads every number of data_file into a new array the caller frees,
+// returning NULL if the file can't be opened or memory runs out
+int *reader_load(const char *data_file, size_t *count)
+{
+    reader r;
+    if (!reader_open(&r, data_file))
+    {
+        return NULL;
+    }
+
+    // binary datasets know their size up front
+    size_t capacity = (r.count > 0) ? r.count : 1024;
+    int *numbers = malloc(capacity * sizeof(int));
+    *count = 0;
+
+    while (numbers != NULL)
+    {
+        // a binary dataset is done once its header's count is read, with no need to grow
+        if (r.binary && *count == r.count)
+        {
+            break;
+        }
+
+        // double the array whenever it fills up
+        if (*count == capacity)
+        {
+            capacity *= 2;
+            int *bigger = realloc(numbers, capacity * sizeof(int));
+            if (bigger == NULL)
+            {
+                free(numbers);
+                numbers = NULL;
+                break;
+            }
+            numbers = bigger;
+        }
+
+        size_t n = reader_fill(&r, numbers + *count, capacity - *count);
+        if (n == 0)
+        {
+            break;
+        }
+        *count += n;
+    }
+
+    reader_close(&r);
+    return numbers;
+}
+
+// Unmaps the dataset from memory
+void reader_close(reader *r)
+{
+    if (r->data != NULL)
+    {
+        munmap((void *) r->data, r->size);
+    }
+    r->data = NULL;
+    r->cursor = NULL;
+    r->end = NULL;
+    r->size = 0;
+    r->binary = false;
+    r->count = 0;
+    r->next = 0;
+    r->filled = 0;
+}
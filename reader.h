@@ -0,0 +1,36 @@
+#ifndef READER_H
+#define READER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Numbers parsed ahead of reader_next in one go
+#define READER_BATCH 256
+
+// Represents a dataset file mapped into memory
+typedef struct reader
+{
+    const char *data;
+    const char *cursor;
+    const char *end;
+    size_t size;
+
+    // set when the file is a binary dataset (see dataset.h)
+    bool binary;
+    size_t count;
+    unsigned int order;
+
+    // numbers parsed but not yet handed out by reader_next
+    int batch[READER_BATCH];
+    size_t next;
+    size_t filled;
+} reader;
+
+bool reader_open(reader *r, const char *data_file);
+bool reader_next(reader *r, int *number);
+size_t reader_fill(reader *r, int *numbers, size_t max);
+size_t reader_count(const reader *r);
+int *reader_load(const char *data_file, size_t *count);
+void reader_close(reader *r);
+
+#endif
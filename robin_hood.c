@@ -0,0 +1,389 @@
+// Robin Hood hash table that loads a dataset, searches and deletes specific values,
+// and finally deletes the remainder of the dataset from memory
+
+// Same flat array of inline keys and linear probing as the open addressing
+// table, but an insert that meets a key closer to its home slot than the
+// new one takes that slot and carries the displaced key on ("takes from
+// the rich"). Every run is then ordered by displacement, which keeps the
+// longest probes short even at high load, and lets a lookup stop as soon
+// as it reaches a key closer to home than itself instead of walking to
+// the end of the run, so misses are about as cheap as hits
+
+// Displacements aren't stored: they are recomputed from the key's hash,
+// which keeps a slot at 4 bytes
+
+// After loading, the table prints its load factor, the mean and maximum
+// probe length and a histogram of displacements, and before unloading
+// the average probes the fused searches and deletes took (plain lookups
+// aren't counted, so they never write to the table)
+
+#include "robin_hood.h"
+
+// Everything one table owns
+struct rhtable
+{
+    int *slots;
+    size_t capacity;
+    size_t count;
+    bool zero;
+    // probes taken by the deletes since the last load
+    size_t hits, hitProbes;
+    size_t misses, missProbes;
+    memstats mem;
+};
+
+// How many lookups a batch runs side by side, and how far ahead batched inserts prefetch
+#define RH_GROUP 16
+#define RH_PREFETCH 8
+
+// Function prototypes
+bool rh_ingest(void *t, int number);
+size_t rh_home(const rhtable *t, int number);
+size_t rh_distance(const rhtable *t, size_t slot);
+bool rh_find(rhtable *t, int number, size_t *slot);
+void rh_tally(rhtable *t, int number, size_t slot, bool found);
+bool rh_resize(rhtable *t, size_t capacity);
+void rh_place(rhtable *t, int number);
+void rh_statistics(const rhtable *t);
+
+// Global variables
+double rh_max_load = RH_MAX_LOAD;
+
+// Creates an empty table, returning NULL if out of memory
+// The slot array is allocated with the first number
+rhtable *rh_create(void)
+{
+    return calloc(1, sizeof(rhtable));
+}
+
+// Frees the table and every number left in it
+void rh_destroy(rhtable *t)
+{
+    if (t != NULL)
+    {
+        rh_unload(t);
+        free(t);
+    }
+}
+
+// Sets the share of slots every table may fill before doubling,
+// returning false if it is out of range
+bool rh_load(double load)
+{
+    if (load < 0.1 || load > 0.99)
+    {
+        return false;
+    }
+    rh_max_load = load;
+    return true;
+}
+
+// Loads database into memory, returning true if successful, else false
+bool rh_insert(rhtable *t, const char *data_file)
+{
+    mem_reset(&t->mem);
+
+    if (!ingest(data_file, rh_ingest, t))
+    {
+        rh_unload(t);
+        return false;
+    }
+
+    // Print how far the keys ended up from home
+    rh_statistics(t);
+    return true;
+}
+
+// Adds a single number to the table, returning false if out of memory
+bool rh_add(rhtable *t, int number)
+{
+    if (number == 0)
+    {
+        t->count += !t->zero;
+        t->zero = true;
+        return true;
+    }
+
+    size_t slot;
+    if (t->slots != NULL && rh_find(t, number, &slot))
+    {
+        return true;
+    }
+
+    // grow before the table gets too full for short probes
+    if (t->slots == NULL || t->count + 1 > t->capacity * rh_max_load)
+    {
+        if (!rh_resize(t, (t->slots == NULL) ? RH_MIN_CAPACITY : t->capacity * 2))
+        {
+            return false;
+        }
+    }
+
+    rh_place(t, number);
+    t->count++;
+    return true;
+}
+
+// Adds n numbers, returning false if out of memory
+// The home slot of the key RH_PREFETCH places ahead is prefetched while
+// the current key is placed
+bool rh_add_batch(rhtable *t, const int *keys, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        if (i + RH_PREFETCH < n && t->slots != NULL)
+        {
+            __builtin_prefetch(&t->slots[rh_home(t, keys[i + RH_PREFETCH])], 1);
+        }
+        if (!rh_add(t, keys[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// rh_add in the shape ingest calls it
+bool rh_ingest(void *t, int number)
+{
+    return rh_add(t, number);
+}
+
+// Returns the allocation counters of the table
+memstats *rh_memory(rhtable *t)
+{
+    return &t->mem;
+}
+
+// Searches for a number and deletes it if found, the benchmark's fused operation
+bool rh_search(rhtable *t, int numbers)
+{
+    return rh_remove(t, numbers);
+}
+
+// Returns true if number is in the table, leaving the table untouched
+bool rh_contains(rhtable *t, int number)
+{
+    if (number == 0 || t->slots == NULL)
+    {
+        return number == 0 && t->zero;
+    }
+
+    size_t slot;
+    return rh_find(t, number, &slot);
+}
+
+// Looks up n numbers, setting found[i] for each, and returns how many were found
+// The home slots of a group of RH_GROUP keys are prefetched before any of
+// them is probed, so their cache misses overlap
+size_t rh_contains_batch(rhtable *t, const int *keys, size_t n, bool *found)
+{
+    size_t hits = 0;
+    for (size_t base = 0; base < n; base += RH_GROUP)
+    {
+        size_t group = (n - base < RH_GROUP) ? n - base : RH_GROUP;
+        if (t->slots != NULL)
+        {
+            for (size_t j = 0; j < group; j++)
+            {
+                __builtin_prefetch(&t->slots[rh_home(t, keys[base + j])]);
+            }
+        }
+        for (size_t j = 0; j < group; j++)
+        {
+            found[base + j] = rh_contains(t, keys[base + j]);
+            hits += found[base + j];
+        }
+    }
+    return hits;
+}
+
+// Deletes number from the table, returning false if it wasn't there
+bool rh_remove(rhtable *t, int number)
+{
+    if (number == 0 || t->slots == NULL)
+    {
+        if (number != 0 || !t->zero)
+        {
+            return false;
+        }
+        t->zero = false;
+        t->count--;
+        return true;
+    }
+
+    size_t hole;
+    bool found = rh_find(t, number, &hole);
+    rh_tally(t, number, hole, found);
+    if (!found)
+    {
+        return false;
+    }
+
+    // backward shift: every later key of the run that isn't home moves
+    // back one slot, which keeps the run ordered by displacement
+    size_t mask = t->capacity - 1;
+    for (size_t i = (hole + 1) & mask; t->slots[i] != 0 && rh_distance(t, i) > 0; i = (i + 1) & mask)
+    {
+        t->slots[hole] = t->slots[i];
+        hole = i;
+    }
+    t->slots[hole] = 0;
+    t->count--;
+    return true;
+}
+
+// Frees the slot array, leaving an empty table
+void rh_unload(rhtable *t)
+{
+    if (t->hits + t->misses > 0)
+    {
+        printf("     PROBES PER SEARCH: %.2f when found, %.2f when missing\n",
+               t->hits > 0 ? (double) t->hitProbes / t->hits : 0.0,
+               t->misses > 0 ? (double) t->missProbes / t->misses : 0.0);
+    }
+
+    if (t->slots != NULL)
+    {
+        mem_free(&t->mem, t->slots, t->capacity * sizeof(int));
+    }
+    t->slots = NULL;
+    t->capacity = 0;
+    t->count = 0;
+    t->zero = false;
+    t->hits = t->hitProbes = 0;
+    t->misses = t->missProbes = 0;
+}
+
+// Home slot of a number: the top bits of number * 2^32 / Phi (golden number)
+size_t rh_home(const rhtable *t, int number)
+{
+    uint64_t product = (uint64_t) ((uint32_t) number * 2654435761u);
+    return (size_t) ((product * t->capacity) >> 32);
+}
+
+// How many slots past its home the key in slot sits
+size_t rh_distance(const rhtable *t, size_t slot)
+{
+    return (slot - rh_home(t, t->slots[slot])) & (t->capacity - 1);
+}
+
+// Finds the slot holding number, returning false as soon as the probe
+// passes the point where number would have had to be
+// slot is left at the last slot probed either way
+bool rh_find(rhtable *t, int number, size_t *slot)
+{
+    size_t mask = t->capacity - 1;
+    size_t i = rh_home(t, number);
+    for (size_t d = 0; t->slots[i] != 0 && rh_distance(t, i) >= d; d++)
+    {
+        if (t->slots[i] == number)
+        {
+            *slot = i;
+            return true;
+        }
+        i = (i + 1) & mask;
+    }
+    *slot = i;
+    return false;
+}
+
+// Counts the probes a search for number took to end at slot
+void rh_tally(rhtable *t, int number, size_t slot, bool found)
+{
+    size_t probes = ((slot - rh_home(t, number)) & (t->capacity - 1)) + 1;
+    if (found)
+    {
+        t->hits++;
+        t->hitProbes += probes;
+    }
+    else
+    {
+        t->misses++;
+        t->missProbes += probes;
+    }
+}
+
+// Moves every number into a new array of capacity slots, returning false if out of memory
+bool rh_resize(rhtable *t, size_t capacity)
+{
+    int *slots = mem_calloc(&t->mem, capacity, sizeof(int));
+    if (slots == NULL)
+    {
+        return false;
+    }
+
+    int *old = t->slots;
+    size_t oldCapacity = t->capacity;
+    t->slots = slots;
+    t->capacity = capacity;
+
+    for (size_t i = 0; i < oldCapacity; i++)
+    {
+        if (old[i] != 0)
+        {
+            rh_place(t, old[i]);
+        }
+    }
+
+    if (old != NULL)
+    {
+        mem_free(&t->mem, old, oldCapacity * sizeof(int));
+    }
+    return true;
+}
+
+// Puts a number known not to be in the table into its run, swapping it
+// with any key it finds closer to home than itself and carrying that one on
+void rh_place(rhtable *t, int number)
+{
+    size_t mask = t->capacity - 1;
+    size_t i = rh_home(t, number);
+    for (size_t d = 0; t->slots[i] != 0; d++)
+    {
+        size_t resident = rh_distance(t, i);
+        if (resident < d)
+        {
+            int rich = t->slots[i];
+            t->slots[i] = number;
+            number = rich;
+            d = resident;
+        }
+        i = (i + 1) & mask;
+    }
+    t->slots[i] = number;
+}
+
+// Prints the load factor, probe lengths and displacement histogram
+void rh_statistics(const rhtable *t)
+{
+    size_t displaced[RH_HISTOGRAM] = {0};
+    size_t keys = 0, total = 0, longest = 0;
+
+    for (size_t i = 0; i < t->capacity; i++)
+    {
+        if (t->slots[i] != 0)
+        {
+            size_t d = rh_distance(t, i);
+            displaced[(d < RH_HISTOGRAM - 1) ? d : RH_HISTOGRAM - 1]++;
+            total += d + 1;
+            longest = (d + 1 > longest) ? d + 1 : longest;
+            keys++;
+        }
+    }
+
+    printf("     =============\n");
+    printf("     ROBIN HOOD PROBES\n");
+    printf("     load = %.3f (max %.2f), probe length mean = %.3f, max = %zu\n",
+           t->capacity > 0 ? (double) keys / t->capacity : 0.0, rh_max_load,
+           keys > 0 ? (double) total / keys : 0.0, longest);
+    for (int d = 0; d < RH_HISTOGRAM; d++)
+    {
+        if (displaced[d] > 0)
+        {
+            printf("     displacement %2d%s %10zu  %6.2f%%\n", d, (d == RH_HISTOGRAM - 1) ? "+" : " ",
+                   displaced[d], 100.0 * displaced[d] / keys);
+        }
+    }
+    printf("     =============\n");
+}
@@ -0,0 +1,38 @@
+#ifndef ROBIN_HOOD_H
+#define ROBIN_HOOD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ingest.h"
+#include "memory.h"
+
+// Smallest table, in slots (a power of two)
+#define RH_MIN_CAPACITY 1024
+
+// Default share of slots used before the table doubles; Robin Hood
+// keeps probes short up to much higher loads than plain linear probing
+#define RH_MAX_LOAD 0.9
+
+// Displacements counted one by one in the histogram, the last bucket takes the rest
+#define RH_HISTOGRAM 16
+
+// A Robin Hood hash table, only handled through the functions below
+typedef struct rhtable rhtable;
+
+rhtable *rh_create(void);
+void rh_destroy(rhtable *t);
+bool rh_load(double load);
+bool rh_insert(rhtable *t, const char *data_file);
+bool rh_add(rhtable *t, int number);
+bool rh_add_batch(rhtable *t, const int *keys, size_t n);
+memstats *rh_memory(rhtable *t);
+bool rh_search(rhtable *t, int numbers);
+bool rh_contains(rhtable *t, int number);
+size_t rh_contains_batch(rhtable *t, const int *keys, size_t n, bool *found);
+bool rh_remove(rhtable *t, int number);
+void rh_unload(rhtable *t);
+
+#endif
@@ -0,0 +1,567 @@
+// Shared-nothing hash table: the numbers are split by hash between shards,
+// each a chained hash table (hashing.c) that only its own thread ever
+// touches, so no shard needs a lock or an atomic of its own
+
+// The calling thread routes every number to its shard through a ring of
+// batches with one producer and one consumer, like the reader's ring of
+// the pipelined ingest, and the shards' threads run their batches side by
+// side. A call returns once every shard has finished its share, so each
+// call costs a round trip to the shards: the batched calls spread it over
+// thousands of numbers, the single-number calls pay it for every number
+
+// An idle shard polls its ring for a while, then sleeps on a condition
+// variable until the caller publishes its next batch
+
+// Only one thread may call the functions of a table at a time
+
+#define _DEFAULT_SOURCE
+
+#include <sched.h>
+
+#include "harness.h"
+#include "sharded_hash.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// What a batch asks its shard to do
+#define SD_ADD 0
+#define SD_SEARCH 1
+#define SD_CONTAINS 2
+#define SD_REMOVE 3
+#define SD_LOAD 4
+#define SD_UNLOAD 5
+#define SD_STOP 6
+
+// Numbers for one shard, and where their results go
+typedef struct sdbatch
+{
+    int op;
+    size_t count;
+    // the caller's array of results, indexed by index[i], or NULL
+    bool *found;
+    int keys[SD_BATCH];
+    size_t index[SD_BATCH];
+    bool result[SD_BATCH];
+} sdbatch;
+
+// One shard: its table, its thread and the ring between it and the caller
+// head and tail only ever grow, and live on separate cache lines
+typedef struct shard
+{
+    sdbatch *slots;
+    hashtable *table;
+    pthread_t thread;
+    int cpu;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    // the caller's side: batches published, and the one being filled
+    _Alignas(64) atomic_size_t head;
+    sdbatch *open;
+    // the thread's side: batches finished, numbers found since the call
+    // started, and whether an insert ran out of memory
+    _Alignas(64) atomic_size_t tail;
+    atomic_bool sleeping;
+    atomic_bool failed;
+    size_t hits;
+} shard;
+
+// Everything one sharded table owns
+struct sdtable
+{
+    shard *shards;
+    int count;
+    // the rings, and what sd_memory adds up over the shards
+    memstats mem;
+    memstats total;
+};
+
+// Function prototypes
+bool sd_start(shard *s, int cpu);
+void *sd_work(void *arg);
+void sd_idle(shard *s, size_t tail);
+void sd_execute(shard *s, sdbatch *b);
+bool sd_ingest(void *t, int number);
+unsigned int sd_shard(const sdtable *t, int number);
+bool sd_push(sdtable *t, int op, int number, bool *found, size_t index);
+sdbatch *sd_open(shard *s, int op, bool *found);
+void sd_publish(shard *s);
+void sd_flush(sdtable *t);
+bool sd_wait(sdtable *t);
+void sd_broadcast(sdtable *t, int op);
+size_t sd_run(sdtable *t, int op, const int *keys, size_t n, bool *found);
+void sd_pause(int spins);
+
+// Global variables
+int sd_count = SD_SHARDS;
+int sd_cpu = -1;
+
+// Splits every following table into shards, pinning shard i to CPU cpu + i,
+// or leaving them unpinned if cpu is negative
+// Returns false if shards is out of range
+bool sd_shards(int shards, int cpu)
+{
+    if (shards < 1 || shards > SD_MAX_SHARDS)
+    {
+        return false;
+    }
+    sd_count = shards;
+    sd_cpu = cpu;
+    return true;
+}
+
+// Creates an empty table and starts the thread of every shard,
+// returning NULL if out of memory or a thread can't start
+sdtable *sd_create(void)
+{
+    sdtable *t = calloc(1, sizeof(sdtable));
+    if (t == NULL)
+    {
+        return NULL;
+    }
+    t->shards = aligned_alloc(_Alignof(shard), sd_count * sizeof(shard));
+    if (t->shards == NULL)
+    {
+        free(t);
+        return NULL;
+    }
+    memset(t->shards, 0, sd_count * sizeof(shard));
+    mem_fixed(&t->mem, sd_count * (sizeof(shard) + SD_SLOTS * sizeof(sdbatch)));
+
+    for (; t->count < sd_count; t->count++)
+    {
+        if (!sd_start(&t->shards[t->count], (sd_cpu >= 0) ? sd_cpu + t->count : -1))
+        {
+            sd_destroy(t);
+            return NULL;
+        }
+    }
+    return t;
+}
+
+// Stops the shards' threads and frees the table and every number left in it
+void sd_destroy(sdtable *t)
+{
+    if (t == NULL)
+    {
+        return;
+    }
+    sd_broadcast(t, SD_STOP);
+    for (int i = 0; i < t->count; i++)
+    {
+        shard *s = &t->shards[i];
+        pthread_join(s->thread, NULL);
+        hash_destroy(s->table);
+        pthread_mutex_destroy(&s->lock);
+        pthread_cond_destroy(&s->wake);
+        free(s->slots);
+    }
+    free(t->shards);
+    free(t);
+}
+
+// Loads database into memory, returning true if successful, else false
+bool sd_insert(sdtable *t, const char *data_file)
+{
+    mem_reset(&t->mem);
+    sd_broadcast(t, SD_LOAD);
+
+    bool loaded = ingest(data_file, sd_ingest, t);
+    sd_flush(t);
+    loaded = sd_wait(t) && loaded;
+    // the shards were loaded number by number, so their resizes are forgotten
+    // here instead of being reported as the searches'
+    sd_resizes(t, NULL);
+
+    if (!loaded)
+    {
+        sd_unload(t);
+        return false;
+    }
+    return true;
+}
+
+// Adds a single number to the table, returning false if out of memory
+bool sd_add(sdtable *t, int number)
+{
+    return sd_add_batch(t, &number, 1);
+}
+
+// Adds n numbers, returning false if out of memory
+bool sd_add_batch(sdtable *t, const int *keys, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        sd_push(t, SD_ADD, keys[i], NULL, 0);
+    }
+    sd_flush(t);
+    return sd_wait(t);
+}
+
+// Routes a number without waiting for its shard, the way ingest calls it
+// Returns false once a shard has run out of memory
+bool sd_ingest(void *t, int number)
+{
+    return sd_push(t, SD_ADD, number, NULL, 0);
+}
+
+// Returns the allocation counters of the table, added up over the shards
+// Every shard reaches its peak at a different moment, so the peak is an upper bound
+memstats *sd_memory(sdtable *t)
+{
+    t->total = t->mem;
+    for (int i = 0; i < t->count; i++)
+    {
+        const memstats *m = hash_memory(t->shards[i].table);
+        t->total.live += m->live;
+        t->total.peak += m->peak;
+        t->total.allocations += m->allocations;
+        t->total.frees += m->frees;
+    }
+    return &t->total;
+}
+
+// Searches for a number and deletes it if found, the benchmark's fused operation
+bool sd_search(sdtable *t, int numbers)
+{
+    return sd_run(t, SD_SEARCH, &numbers, 1, NULL) > 0;
+}
+
+// Searches for n numbers and deletes the ones found, setting found[i] for
+// each unless found is NULL, and returns how many were found
+size_t sd_search_batch(sdtable *t, const int *keys, size_t n, bool *found)
+{
+    return sd_run(t, SD_SEARCH, keys, n, found);
+}
+
+// Returns true if number is in the table, leaving the table untouched
+bool sd_contains(sdtable *t, int number)
+{
+    return sd_run(t, SD_CONTAINS, &number, 1, NULL) > 0;
+}
+
+// Looks up n numbers, setting found[i] for each unless found is NULL,
+// and returns how many were found
+// Every shard looks its share up with hash_contains_batch
+size_t sd_contains_batch(sdtable *t, const int *keys, size_t n, bool *found)
+{
+    return sd_run(t, SD_CONTAINS, keys, n, found);
+}
+
+// Deletes number from the table, returning false if it wasn't there
+bool sd_remove(sdtable *t, int number)
+{
+    return sd_run(t, SD_REMOVE, &number, 1, NULL) > 0;
+}
+
+// Deletes n numbers, setting found[i] for each unless found is NULL,
+// and returns how many were there
+size_t sd_remove_batch(sdtable *t, const int *keys, size_t n, bool *found)
+{
+    return sd_run(t, SD_REMOVE, keys, n, found);
+}
+
+// Empties every shard, keeping their threads
+void sd_unload(sdtable *t)
+{
+    sd_broadcast(t, SD_UNLOAD);
+}
+
+// Prints how often the shards resized since the last report, added up,
+// with their buckets added up and, while latencies are sampled, the
+// longest single operation a resize caused in any of them, then clears
+// their counters
+// With a NULL phase they are only cleared
+// The shards are idle between calls, so their counters are read from here
+void sd_resizes(sdtable *t, const char *phase)
+{
+    unsigned int resizes = 0, buckets = 0;
+    uint64_t worst = 0;
+    for (int i = 0; i < t->count; i++)
+    {
+        unsigned int size;
+        uint64_t pause;
+        resizes += hash_resized(t->shards[i].table, &size, &pause);
+        buckets += size;
+        worst = (pause > worst) ? pause : worst;
+    }
+
+    if (resizes > 0 && phase != NULL && ingest_sampling())
+    {
+        printf("     RESIZES WHILE %s: %u over %d shards, now %u buckets, longest pause %.1f us\n",
+               phase, resizes, t->count, buckets, latency_ns(worst) / 1000.0);
+    }
+    else if (resizes > 0 && phase != NULL)
+    {
+        printf("     RESIZES WHILE %s: %u over %d shards, now %u buckets\n", phase, resizes, t->count, buckets);
+    }
+}
+
+// Creates a shard's table and ring and starts its thread on cpu (if not negative)
+// Returns false, having freed them again, if any of it fails
+bool sd_start(shard *s, int cpu)
+{
+    s->slots = malloc(SD_SLOTS * sizeof(sdbatch));
+    s->table = hash_create();
+    if (s->slots == NULL || s->table == NULL)
+    {
+        free(s->slots);
+        hash_destroy(s->table);
+        return false;
+    }
+    s->cpu = cpu;
+    s->open = NULL;
+    s->hits = 0;
+    atomic_init(&s->head, 0);
+    atomic_init(&s->tail, 0);
+    atomic_init(&s->sleeping, false);
+    atomic_init(&s->failed, false);
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->wake, NULL);
+
+    if (pthread_create(&s->thread, NULL, sd_work, s) != 0)
+    {
+        pthread_mutex_destroy(&s->lock);
+        pthread_cond_destroy(&s->wake);
+        free(s->slots);
+        hash_destroy(s->table);
+        return false;
+    }
+    return true;
+}
+
+// A shard's thread: runs the batches of its ring in order until told to stop
+void *sd_work(void *arg)
+{
+    shard *s = arg;
+    if (s->cpu >= 0 && !harness_pin(s->cpu))
+    {
+        printf("Could not pin to cpu %d.\n", s->cpu);
+    }
+
+    size_t tail = 0;
+    bool stop = false;
+    while (!stop)
+    {
+        sd_idle(s, tail);
+        sdbatch *b = &s->slots[tail % SD_SLOTS];
+        stop = (b->op == SD_STOP);
+        sd_execute(s, b);
+
+        // hand the slot, and the results in it, back to the caller
+        atomic_store_explicit(&s->tail, ++tail, memory_order_release);
+    }
+    return NULL;
+}
+
+// Waits until the caller publishes a batch past tail, polling the ring
+// SD_SPINS times before going to sleep
+void sd_idle(shard *s, size_t tail)
+{
+    for (int spins = 0; atomic_load_explicit(&s->head, memory_order_acquire) == tail; spins++)
+    {
+        if (spins < SD_SPINS)
+        {
+#if defined(__SSE2__)
+            _mm_pause();
+#endif
+            continue;
+        }
+
+        // sleeping is raised before head is checked, and the caller checks
+        // it after publishing, so one of them always sees the other
+        pthread_mutex_lock(&s->lock);
+        atomic_store(&s->sleeping, true);
+        while (atomic_load(&s->head) == tail)
+        {
+            pthread_cond_wait(&s->wake, &s->lock);
+        }
+        atomic_store(&s->sleeping, false);
+        pthread_mutex_unlock(&s->lock);
+    }
+}
+
+// Runs one batch against the shard's table, copying the results out to the caller's array
+void sd_execute(shard *s, sdbatch *b)
+{
+    if (b->op == SD_ADD)
+    {
+        if (!hash_add_batch(s->table, b->keys, b->count))
+        {
+            atomic_store_explicit(&s->failed, true, memory_order_relaxed);
+        }
+    }
+    else if (b->op == SD_CONTAINS)
+    {
+        s->hits += hash_contains_batch(s->table, b->keys, b->count, b->result);
+    }
+    else if (b->op == SD_SEARCH || b->op == SD_REMOVE)
+    {
+        for (size_t i = 0; i < b->count; i++)
+        {
+            b->result[i] = (b->op == SD_SEARCH) ? hash_search(s->table, b->keys[i]) : hash_remove(s->table, b->keys[i]);
+            s->hits += b->result[i];
+        }
+    }
+    else if (b->op == SD_LOAD)
+    {
+        mem_reset(hash_memory(s->table));
+        atomic_store_explicit(&s->failed, false, memory_order_relaxed);
+    }
+    else if (b->op == SD_UNLOAD)
+    {
+        hash_unload(s->table);
+    }
+
+    if (b->found != NULL)
+    {
+        for (size_t i = 0; i < b->count; i++)
+        {
+            b->found[b->index[i]] = b->result[i];
+        }
+    }
+}
+
+// Picks a number's shard from the top bits of its hash multiplied once
+// more by an odd constant (MurmurHash3's): only the top bits are mixed
+// well (hashfunc.c), and the multiply stirs the rest of the hash into
+// them, so the shards' own tables, which pick buckets by the plain top
+// bits, still spread their numbers over every bucket
+unsigned int sd_shard(const sdtable *t, int number)
+{
+    uint32_t h = hashfn(number) * UINT32_C(0x85ebca6b);
+    return ((uint64_t) h * (unsigned int) t->count) >> 32;
+}
+
+// Adds a number to the batch its shard is being sent, publishing the batch once it is full
+// Returns false if the shard has run out of memory
+bool sd_push(sdtable *t, int op, int number, bool *found, size_t index)
+{
+    shard *s = &t->shards[sd_shard(t, number)];
+    sdbatch *b = sd_open(s, op, found);
+    b->keys[b->count] = number;
+    b->index[b->count] = index;
+    if (++b->count < SD_BATCH)
+    {
+        return true;
+    }
+    sd_publish(s);
+    return !atomic_load_explicit(&s->failed, memory_order_relaxed);
+}
+
+// Returns the batch being filled for a shard, or claims the next slot of
+// its ring for a new one, waiting for the shard to free it
+// Every call publishes its batches before returning, so an open batch
+// always has the op and results array of the running call
+sdbatch *sd_open(shard *s, int op, bool *found)
+{
+    if (s->open == NULL)
+    {
+        size_t head = atomic_load_explicit(&s->head, memory_order_relaxed);
+        for (int spins = 0; head - atomic_load_explicit(&s->tail, memory_order_acquire) == SD_SLOTS; spins++)
+        {
+            sd_pause(spins);
+        }
+        s->open = &s->slots[head % SD_SLOTS];
+        s->open->op = op;
+        s->open->count = 0;
+        s->open->found = found;
+    }
+    return s->open;
+}
+
+// Hands a shard its open batch, waking its thread if it went to sleep
+void sd_publish(shard *s)
+{
+    s->open = NULL;
+    atomic_fetch_add(&s->head, 1);
+    if (atomic_load(&s->sleeping))
+    {
+        pthread_mutex_lock(&s->lock);
+        pthread_cond_signal(&s->wake);
+        pthread_mutex_unlock(&s->lock);
+    }
+}
+
+// Publishes every batch still being filled
+void sd_flush(sdtable *t)
+{
+    for (int i = 0; i < t->count; i++)
+    {
+        if (t->shards[i].open != NULL)
+        {
+            sd_publish(&t->shards[i]);
+        }
+    }
+}
+
+// Waits for every shard to finish the batches it was sent, returning
+// false if one of them ran out of memory
+bool sd_wait(sdtable *t)
+{
+    bool ok = true;
+    for (int i = 0; i < t->count; i++)
+    {
+        shard *s = &t->shards[i];
+        size_t head = atomic_load_explicit(&s->head, memory_order_relaxed);
+        for (int spins = 0; atomic_load_explicit(&s->tail, memory_order_acquire) != head; spins++)
+        {
+            sd_pause(spins);
+        }
+        ok = ok && !atomic_load_explicit(&s->failed, memory_order_relaxed);
+    }
+    return ok;
+}
+
+// Sends every shard an empty batch running op, and waits for all of them
+void sd_broadcast(sdtable *t, int op)
+{
+    sd_flush(t);
+    for (int i = 0; i < t->count; i++)
+    {
+        sd_open(&t->shards[i], op, NULL);
+        sd_publish(&t->shards[i]);
+    }
+    sd_wait(t);
+}
+
+// Routes n numbers to their shards, waits for the shards to run op on all
+// of them, and returns how many were found
+size_t sd_run(sdtable *t, int op, const int *keys, size_t n, bool *found)
+{
+    // the shards are idle between calls, so their counts can be cleared here
+    for (int i = 0; i < t->count; i++)
+    {
+        t->shards[i].hits = 0;
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        sd_push(t, op, keys[i], found, i);
+    }
+    sd_flush(t);
+    sd_wait(t);
+
+    size_t hits = 0;
+    for (int i = 0; i < t->count; i++)
+    {
+        hits += t->shards[i].hits;
+    }
+    return hits;
+}
+
+// Backs off while waiting for a shard, yielding the CPU every SD_SPINS
+// polls in case the shard's thread needs it
+void sd_pause(int spins)
+{
+    if (spins % SD_SPINS == SD_SPINS - 1)
+    {
+        sched_yield();
+    }
+#if defined(__SSE2__)
+    else
+    {
+        _mm_pause();
+    }
+#endif
+}
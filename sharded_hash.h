@@ -0,0 +1,50 @@
+#ifndef SHARDED_HASH_H
+#define SHARDED_HASH_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hashfunc.h"
+#include "hashing.h"
+#include "ingest.h"
+#include "memory.h"
+
+// Shards sd_create starts unless sd_shards picked another number, and the most it accepts
+#define SD_SHARDS 4
+#define SD_MAX_SHARDS 256
+
+// Numbers handed to a shard at once
+#define SD_BATCH 256
+
+// Batches queued per shard before the caller waits for its thread
+#define SD_SLOTS 8
+
+// Polls of an empty queue before a shard's thread sleeps until the next
+// batch, and polls of a full one before the caller yields its CPU
+#define SD_SPINS 256
+
+// A hash table split into shards, each owned by a thread of its own, only handled through the functions below
+typedef struct sdtable sdtable;
+
+bool sd_shards(int shards, int cpu);
+sdtable *sd_create(void);
+void sd_destroy(sdtable *t);
+bool sd_insert(sdtable *t, const char *data_file);
+bool sd_add(sdtable *t, int number);
+bool sd_add_batch(sdtable *t, const int *keys, size_t n);
+memstats *sd_memory(sdtable *t);
+bool sd_search(sdtable *t, int numbers);
+size_t sd_search_batch(sdtable *t, const int *keys, size_t n, bool *found);
+bool sd_contains(sdtable *t, int number);
+size_t sd_contains_batch(sdtable *t, const int *keys, size_t n, bool *found);
+bool sd_remove(sdtable *t, int number);
+size_t sd_remove_batch(sdtable *t, const int *keys, size_t n, bool *found);
+void sd_unload(sdtable *t);
+void sd_resizes(sdtable *t, const char *phase);
+
+#endif
@@ -13,89 +13,175 @@
 #include "sing_linkedlist.h"
 
 
-// Global Variables
-node *head = NULL;
-node *tail = NULL;
+// Everything one list owns
+struct sll
+{
+    node *head;
+    node *tail;
+    memstats mem;
+};
+
+// Function prototypes
+bool sll_ingest(void *l, int number);
+
+// Creates an empty list, returning NULL if out of memory
+sll *sll_create(void)
+{
+    return calloc(1, sizeof(sll));
+}
+
+// Frees the list and every number left in it
+void sll_destroy(sll *l)
+{
+    if (l != NULL)
+    {
+        sll_unload(l);
+        free(l);
+    }
+}
 
 // Inserts the dataset into the singly linked list
-bool sll_insert(const char *data_file)
+bool sll_insert(sll *l, const char *data_file)
+{
+    mem_reset(&l->mem);
+
+    if (!ingest(data_file, sll_ingest, l))
+    {
+        sll_unload(l);
+        return false;
+    }
+    return true;
+}
+
+// Adds a single number to the sorted list, returning false if out of memory
+bool sll_add(sll *l, int number)
 {
-    // open data file
-    FILE *inptr = fopen(data_file, "r");
-    if (inptr == NULL)
+    node *n = mem_alloc(&l->mem, sizeof(node));
+    if (n == NULL)
     {
-        printf("Could not open %s.\n", data_file);
         return false;
     }
 
-    // create a buffer
-    int buffer;
+    n->next = NULL;
+    n->number = number;
 
-    // Build list until reach the end of file
-    while(fscanf(inptr, "%i", &buffer) != EOF)
+    // if list is empty
+    if (l->head == NULL)
     {
-        node *n = malloc(sizeof(node));
-        if (n == NULL)
-        {
-            sll_unload();
-            return false;
-        }
+        l->head = n;
+        l->tail = n;
+    }
+
+    // If number belongs at beginning of list
+    else if (n->number < l->head->number)
+    {
+        n->next = l->head;
+        l->head = n;
+    }
 
-        n->next = NULL;
-        n->number = buffer;
+    // If number is greater than or equal to
+    // the tail, append to the end of the list
+    else if (n->number >= l->tail->number)
+    {
+        l->tail->next = n;
+        l->tail = n;
+    }
 
-        // if list is empty
-        if (head == NULL)
+    // If number belongs in the middle of the list
+    else
+    {
+        // Iterate over nodes in list
+        for (node *cursor = l->head; cursor != NULL; cursor = cursor->next)
         {
-            head = n;
-            tail = n;
+            // if current number is smaller than the next number
+            if (n->number < cursor->next->number)
+            {
+                n->next = cursor->next;
+                cursor->next = n;
+                break;
+            }
         }
+    }
+    return true;
+}
 
-        // If number belongs at beginning of list
-        else if (n->number < head->number)
+// Adds n numbers, returning false if out of memory
+// Each insert walks the list on its own
+bool sll_add_batch(sll *l, const int *keys, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        if (!sll_add(l, keys[i]))
         {
-            n->next = head;
-            head = n;
+            return false;
         }
+    }
+    return true;
+}
+
+// sll_add in the shape ingest calls it
+bool sll_ingest(void *l, int number)
+{
+    return sll_add(l, number);
+}
+
+// Returns the allocation counters of the list
+memstats *sll_memory(sll *l)
+{
+    return &l->mem;
+}
+
+// Searches for a number and deletes it if found, the benchmark's fused operation
+bool sll_search(sll *l, int numbers)
+{
+    return sll_remove(l, numbers);
+}
 
-        // If number is greater than or equal to
-        // the tail, append to the end of the list
-        else if (n->number >= tail->number)
+// Returns true if number is in the list, leaving the list untouched
+bool sll_contains(sll *l, int number)
+{
+    for (node *n = l->head; n != NULL; n = n->next)
+    {
+        if (n->number == number)
         {
-            tail->next = n;
-            tail = n;
+            return true;
         }
+    }
+    return false;
+}
+
+// Looks up n numbers, setting found[i] for each, and returns how many were found
+// The whole batch is answered in one walk over the list instead of one walk per number
+size_t sll_contains_batch(sll *l, const int *keys, size_t n, bool *found)
+{
+    size_t hits = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        found[i] = false;
+    }
 
-        // If number belongs in the middle of the list
-        else
+    for (node *c = l->head; c != NULL && hits < n; c = c->next)
+    {
+        for (size_t i = 0; i < n; i++)
         {
-            // Iterate over nodes in list
-            for (node *cursor = head; cursor != NULL; cursor = cursor->next)
+            if (!found[i] && keys[i] == c->number)
             {
-                // if current number is smaller than the next number
-                if (n->number < cursor->next->number)
-                {
-                    n->next = cursor->next;
-                    cursor->next = n;
-                    break;
-                }
+                found[i] = true;
+                hits++;
             }
         }
     }
-    // Close the data file
-    fclose(inptr);
-
-    return true;
+    return hits;
 }
 
-// Searches a node in the list
-bool sll_search(int numbers)
+// Deletes number from the list, returning false if it wasn't there
+bool sll_remove(sll *l, int numbers)
 {
-    for (node *n = head, *prev = head; n != NULL; n = n->next)
+    for (node *n = l->head, *prev = l->head; n != NULL; n = n->next)
     {
         if (n->number == numbers)
         {
-            sll_delete(n, prev);
+            sll_delete(l, n, prev);
             return true;
         }
         prev = n;
@@ -104,38 +190,46 @@ bool sll_search(int numbers)
 }
 
 // Unloads all memory allocated
-void sll_unload(void)
+void sll_unload(sll *l)
 {
     // access the head of the linked list
-    node *n = head;
+    node *n = l->head;
 
     // free memory inside the linked list until all values are NULL
     while (n != NULL)
     {
         node *temp = n->next;
-        free(n);
+        mem_free(&l->mem, n, sizeof(node));
         n = temp;
     }
+    l->head = NULL;
+    l->tail = NULL;
 }
 
 // Deletes a node from the list
-void sll_delete(node *n, node *prev)
+void sll_delete(sll *l, node *n, node *prev)
 {
     // edge case if n is head
     if (n == prev)
     {
-        head = n->next;
-        free(n);
+        l->head = n->next;
+        // reset the tail too if that emptied the list
+        if (l->head == NULL)
+        {
+            l->tail = NULL;
+        }
+        mem_free(&l->mem, n, sizeof(node));
     }
     // edge case if n is tail
     else if (n->next == NULL)
     {
         prev->next = NULL;
-        free(n);
+        l->tail = prev;
+        mem_free(&l->mem, n, sizeof(node));
     }
     else
     {
         prev->next = n->next;
-        free(n);
+        mem_free(&l->mem, n, sizeof(node));
     }
 }
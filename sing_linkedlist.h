@@ -5,6 +5,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "ingest.h"
+#include "memory.h"
+
 // Represents a node in a linked list
 typedef struct node
 {
@@ -12,9 +15,20 @@ typedef struct node
     struct node *next;
 } node;
 
-bool sll_insert(const char *data_file);
-bool sll_search(int numbers);
-void sll_unload(void);
-void sll_delete(node *n, node *prev);
+// A list, only handled through the functions below
+typedef struct sll sll;
+
+sll *sll_create(void);
+void sll_destroy(sll *l);
+bool sll_insert(sll *l, const char *data_file);
+bool sll_add(sll *l, int number);
+bool sll_add_batch(sll *l, const int *keys, size_t n);
+memstats *sll_memory(sll *l);
+bool sll_search(sll *l, int numbers);
+bool sll_contains(sll *l, int number);
+size_t sll_contains_batch(sll *l, const int *keys, size_t n, bool *found);
+bool sll_remove(sll *l, int number);
+void sll_unload(sll *l);
+void sll_delete(sll *l, node *n, node *prev);
 
 #endif
@@ -0,0 +1,338 @@
+// Chained hash table with lock striping that any number of threads can load,
+// search and delete from at the same time
+
+// A number's bucket is picked by the top bits of its hash, and its stripe,
+// one of SH_STRIPES, by the top SH_STRIPE_BITS of them. Every number of a
+// bucket then has the same stripe, and since there are never fewer buckets
+// than stripes, growing the table never moves a number to another stripe.
+// An operation takes its stripe's spinlock, so threads working on
+// different stripes never wait for each other, and growing the bucket
+// array takes every lock in order
+
+// Each stripe carves its nodes out of its own pool (pool.h) and keeps its
+// own memory counters, so allocating and freeing only ever happen under
+// the stripe's lock. The table only grows, it never shrinks
+
+// Like the AVL tree, the table holds each number once
+
+// Unloading and destroying the table must not overlap with anything else
+
+#define _DEFAULT_SOURCE
+
+#include <sched.h>
+
+#include "striped_hash.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// One lock and the nodes it guards, on cache lines of its own so
+// threads spinning on neighbouring stripes don't slow each other down
+typedef struct stripe
+{
+    _Alignas(64) atomic_bool lock;
+    pool nodes;
+    memstats mem;
+} stripe;
+
+// Everything one hash table owns
+struct shtable
+{
+    stripe stripes[SH_STRIPES];
+    // only changed with every stripe locked, so any one lock keeps them still
+    shnode **table;
+    size_t size;
+    atomic_size_t count;
+    // the bucket array, and what sh_memory adds up over the stripes
+    memstats mem;
+    memstats total;
+};
+
+// Function prototypes
+bool sh_ingest(void *t, int number);
+void sh_lock(stripe *s);
+void sh_unlock(stripe *s);
+bool sh_resize(shtable *t, size_t seen);
+
+// Creates an empty hash table, returning NULL if out of memory
+// The bucket array is allocated with the first number
+shtable *sh_create(void)
+{
+    shtable *t = aligned_alloc(_Alignof(shtable), sizeof(shtable));
+    if (t == NULL)
+    {
+        return NULL;
+    }
+    memset(t, 0, sizeof(shtable));
+    for (int i = 0; i < SH_STRIPES; i++)
+    {
+        atomic_init(&t->stripes[i].lock, false);
+        pool_init(&t->stripes[i].nodes, sizeof(shnode));
+    }
+    atomic_init(&t->count, 0);
+    return t;
+}
+
+// Frees the hash table and every number left in it
+void sh_destroy(shtable *t)
+{
+    if (t != NULL)
+    {
+        sh_unload(t);
+        free(t);
+    }
+}
+
+// Loads database into memory, returning true if successful, else false
+bool sh_insert(shtable *t, const char *data_file)
+{
+    mem_reset(&t->mem);
+    for (int i = 0; i < SH_STRIPES; i++)
+    {
+        mem_reset(&t->stripes[i].mem);
+    }
+
+    if (!ingest(data_file, sh_ingest, t))
+    {
+        sh_unload(t);
+        return false;
+    }
+    return true;
+}
+
+// Adds a single number to the hash table, returning false if out of memory
+bool sh_add(shtable *t, int number)
+{
+    uint32_t h = hashfn(number);
+    stripe *s = &t->stripes[h >> (32 - SH_STRIPE_BITS)];
+    sh_lock(s);
+    while (t->table == NULL)
+    {
+        sh_unlock(s);
+        if (!sh_resize(t, 0))
+        {
+            return false;
+        }
+        sh_lock(s);
+    }
+
+    shnode **bucket = &t->table[((uint64_t) h * t->size) >> 32];
+    for (shnode *n = *bucket; n != NULL; n = n->next)
+    {
+        if (n->number == number)
+        {
+            sh_unlock(s);
+            return true;
+        }
+    }
+
+    shnode *n = pool_alloc(&s->nodes, &s->mem);
+    if (n == NULL)
+    {
+        sh_unlock(s);
+        return false;
+    }
+    n->number = number;
+    n->next = *bucket;
+    *bucket = n;
+    size_t size = t->size;
+    sh_unlock(s);
+
+    // whoever pushes the count past the limit grows the table, unless another thread got there first
+    size_t count = atomic_fetch_add_explicit(&t->count, 1, memory_order_relaxed) + 1;
+    return count <= size * SH_MAX_LOAD || sh_resize(t, size);
+}
+
+// Adds n numbers, returning false if out of memory
+bool sh_add_batch(shtable *t, const int *keys, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        if (!sh_add(t, keys[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// sh_add in the shape ingest calls it
+bool sh_ingest(void *t, int number)
+{
+    return sh_add(t, number);
+}
+
+// Returns the allocation counters of the table, added up over the stripes
+// Every stripe reaches its peak at a different moment, so the peak is an upper bound
+memstats *sh_memory(shtable *t)
+{
+    t->total = t->mem;
+    for (int i = 0; i < SH_STRIPES; i++)
+    {
+        const memstats *m = &t->stripes[i].mem;
+        t->total.live += m->live;
+        t->total.peak += m->peak;
+        t->total.allocations += m->allocations;
+        t->total.frees += m->frees;
+    }
+    return &t->total;
+}
+
+// Searches for a number and deletes it if found, the benchmark's fused operation
+bool sh_search(shtable *t, int numbers)
+{
+    return sh_remove(t, numbers);
+}
+
+// Returns true if number is in the hash table, leaving the table untouched
+bool sh_contains(shtable *t, int number)
+{
+    uint32_t h = hashfn(number);
+    stripe *s = &t->stripes[h >> (32 - SH_STRIPE_BITS)];
+    bool found = false;
+    sh_lock(s);
+    if (t->table != NULL)
+    {
+        for (shnode *n = t->table[((uint64_t) h * t->size) >> 32]; n != NULL && !found; n = n->next)
+        {
+            found = (n->number == number);
+        }
+    }
+    sh_unlock(s);
+    return found;
+}
+
+// Looks up n numbers, setting found[i] for each, and returns how many were found
+// Every lookup takes its own lock, so a batch can't be prefetched ahead
+size_t sh_contains_batch(shtable *t, const int *keys, size_t n, bool *found)
+{
+    size_t hits = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        found[i] = sh_contains(t, keys[i]);
+        hits += found[i];
+    }
+    return hits;
+}
+
+// Deletes number from the hash table, returning false if it wasn't there
+bool sh_remove(shtable *t, int number)
+{
+    uint32_t h = hashfn(number);
+    stripe *s = &t->stripes[h >> (32 - SH_STRIPE_BITS)];
+    sh_lock(s);
+    if (t->table == NULL)
+    {
+        sh_unlock(s);
+        return false;
+    }
+
+    for (shnode **link = &t->table[((uint64_t) h * t->size) >> 32]; *link != NULL; link = &(*link)->next)
+    {
+        shnode *n = *link;
+        if (n->number == number)
+        {
+            *link = n->next;
+            pool_free(&s->nodes, n);
+            sh_unlock(s);
+            atomic_fetch_sub_explicit(&t->count, 1, memory_order_relaxed);
+            return true;
+        }
+    }
+    sh_unlock(s);
+    return false;
+}
+
+// Frees the bucket array and every node, leaving an empty table
+void sh_unload(shtable *t)
+{
+    if (t->table != NULL)
+    {
+        mem_free(&t->mem, t->table, t->size * sizeof(shnode *));
+    }
+    for (int i = 0; i < SH_STRIPES; i++)
+    {
+        pool_release(&t->stripes[i].nodes, &t->stripes[i].mem);
+    }
+    t->table = NULL;
+    t->size = 0;
+    atomic_store(&t->count, 0);
+}
+
+// Takes a stripe's lock, spinning on reads until it looks free
+// After SH_SPINS tries the thread yields, in case the holder was preempted
+void sh_lock(stripe *s)
+{
+    int spins = 0;
+    while (atomic_exchange_explicit(&s->lock, true, memory_order_acquire))
+    {
+        while (atomic_load_explicit(&s->lock, memory_order_relaxed))
+        {
+            if (++spins == SH_SPINS)
+            {
+                spins = 0;
+                sched_yield();
+            }
+#if defined(__SSE2__)
+            _mm_pause();
+#endif
+        }
+    }
+}
+
+// Releases a stripe's lock
+void sh_unlock(stripe *s)
+{
+    atomic_store_explicit(&s->lock, false, memory_order_release);
+}
+
+// Doubles the bucket array, or allocates the first one, with every stripe
+// locked, unless another thread already resized it since it had seen buckets
+// Returns false if out of memory
+bool sh_resize(shtable *t, size_t seen)
+{
+    for (int i = 0; i < SH_STRIPES; i++)
+    {
+        sh_lock(&t->stripes[i]);
+    }
+
+    bool done = true;
+    if (t->size == seen)
+    {
+        size_t size = (seen == 0) ? SH_MIN_BUCKETS : seen * 2;
+        shnode **table = mem_calloc(&t->mem, size, sizeof(shnode *));
+        if (table == NULL)
+        {
+            done = false;
+        }
+        else
+        {
+            // every chain is split over the buckets its numbers now hash to
+            for (size_t b = 0; b < t->size; b++)
+            {
+                shnode *n = t->table[b];
+                while (n != NULL)
+                {
+                    shnode *next = n->next;
+                    shnode **bucket = &table[((uint64_t) hashfn(n->number) * size) >> 32];
+                    n->next = *bucket;
+                    *bucket = n;
+                    n = next;
+                }
+            }
+            if (t->table != NULL)
+            {
+                mem_free(&t->mem, t->table, t->size * sizeof(shnode *));
+            }
+            t->table = table;
+            t->size = size;
+        }
+    }
+
+    for (int i = SH_STRIPES - 1; i >= 0; i--)
+    {
+        sh_unlock(&t->stripes[i]);
+    }
+    return done;
+}
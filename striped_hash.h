@@ -0,0 +1,52 @@
+#ifndef STRIPED_HASH_H
+#define STRIPED_HASH_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hashfunc.h"
+#include "ingest.h"
+#include "memory.h"
+#include "pool.h"
+
+// Locks guarding the buckets; a number's stripe depends only on its hash,
+// never on the table size
+#define SH_STRIPE_BITS 8
+#define SH_STRIPES (1 << SH_STRIPE_BITS)
+
+// Smallest bucket array (a power of two, at least SH_STRIPES)
+#define SH_MIN_BUCKETS 1024
+
+// The table doubles when it holds more numbers per bucket than this
+#define SH_MAX_LOAD 1.0
+
+// Spins on a taken lock before the thread yields its CPU to the holder
+#define SH_SPINS 64
+
+// Represents a node in a striped hash table
+typedef struct shnode
+{
+    int number;
+    struct shnode *next;
+} shnode;
+
+// A hash table that many threads can search and change at once, only handled through the functions below
+typedef struct shtable shtable;
+
+shtable *sh_create(void);
+void sh_destroy(shtable *t);
+bool sh_insert(shtable *t, const char *data_file);
+bool sh_add(shtable *t, int number);
+bool sh_add_batch(shtable *t, const int *keys, size_t n);
+memstats *sh_memory(shtable *t);
+bool sh_search(shtable *t, int numbers);
+bool sh_contains(shtable *t, int number);
+size_t sh_contains_batch(shtable *t, const int *keys, size_t n, bool *found);
+bool sh_remove(shtable *t, int number);
+void sh_unload(shtable *t);
+
+#endif
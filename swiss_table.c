@@ -0,0 +1,385 @@
+// Swiss table that loads a dataset, searches and deletes specific values,
+// and finally deletes the remainder of the dataset from memory
+
+// Next to the array of keys sits an array of one-byte control words, one
+// per slot: empty, deleted, or 7 bits of the key's hash. A lookup loads the
+// 16 control bytes of a group at once and compares them all against the
+// key's 7 bits with SSE2 (or a plain loop where there is no SSE2), and only
+// compares the keys whose bits matched, which is rarely more than one. The
+// probe ends at the first group with an empty slot, so most misses are
+// decided by one 16-byte load without touching a single key
+
+// Groups are probed in triangular steps (1, 2, 3... groups on), which
+// visits every group of a power of two table. Deleting leaves a tombstone
+// only where the group is full, since a group that still has an empty slot
+// never made a probe move on
+
+// The control bytes say which slots are used, so unlike the other open
+// addressing tables any int, 0 included, is stored as it is
+
+// Like the AVL tree, the table holds each number once
+
+#include "swiss_table.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Everything one table owns
+struct swtable
+{
+    uint8_t *ctrl;
+    int *keys;
+    size_t capacity;
+    size_t count;
+    // slots that can still turn from empty to used before the table is rebuilt
+    size_t growth;
+    memstats mem;
+};
+
+// Control bytes of slots that hold no key; a used slot holds 7 bits of hash
+#define SW_EMPTY 0x80
+#define SW_DELETED 0xFE
+
+// How many lookups a batch runs side by side, and how far ahead batched inserts prefetch
+#define SW_GROUP 16
+#define SW_PREFETCH 8
+
+// Function prototypes
+bool sw_ingest(void *t, int number);
+uint64_t sw_hash(int number);
+size_t sw_start(const swtable *t, uint64_t hash);
+uint32_t sw_match(const uint8_t *group, uint8_t byte);
+uint32_t sw_unused(const uint8_t *group);
+bool sw_find(const swtable *t, int number, size_t *slot);
+size_t sw_free_slot(const swtable *t, uint64_t hash);
+bool sw_resize(swtable *t, size_t capacity);
+
+// Global variables
+double sw_max_load = SW_MAX_LOAD;
+
+// Creates an empty table, returning NULL if out of memory
+// The arrays are allocated with the first number
+swtable *sw_create(void)
+{
+    return calloc(1, sizeof(swtable));
+}
+
+// Frees the table and every number left in it
+void sw_destroy(swtable *t)
+{
+    if (t != NULL)
+    {
+        sw_unload(t);
+        free(t);
+    }
+}
+
+// Sets the share of slots every table may fill (or leave deleted)
+// before it is rebuilt,
+// returning false if it is out of range
+bool sw_load(double load)
+{
+    if (load < 0.1 || load > 0.99)
+    {
+        return false;
+    }
+    sw_max_load = load;
+    return true;
+}
+
+// Loads database into memory, returning true if successful, else false
+bool sw_insert(swtable *t, const char *data_file)
+{
+    mem_reset(&t->mem);
+
+    if (!ingest(data_file, sw_ingest, t))
+    {
+        sw_unload(t);
+        return false;
+    }
+    return true;
+}
+
+// Adds a single number to the table, returning false if out of memory
+bool sw_add(swtable *t, int number)
+{
+    size_t slot;
+    if (t->ctrl != NULL && sw_find(t, number, &slot))
+    {
+        return true;
+    }
+
+    // out of empty slots: double if the table is really that full,
+    // else rebuild it at the same size to clear the tombstones
+    if (t->growth == 0)
+    {
+        size_t capacity = SW_MIN_CAPACITY;
+        if (t->ctrl != NULL)
+        {
+            capacity = (t->count + 1 > t->capacity * sw_max_load / 2) ? t->capacity * 2 : t->capacity;
+        }
+        if (!sw_resize(t, capacity))
+        {
+            return false;
+        }
+    }
+
+    uint64_t hash = sw_hash(number);
+    slot = sw_free_slot(t, hash);
+    t->growth -= (t->ctrl[slot] == SW_EMPTY);
+    t->ctrl[slot] = (uint8_t) ((hash >> 25) & 0x7F);
+    t->keys[slot] = number;
+    t->count++;
+    return true;
+}
+
+// Adds n numbers, returning false if out of memory
+// The first group of the key SW_PREFETCH places ahead is prefetched while
+// the current key is placed
+bool sw_add_batch(swtable *t, const int *keys, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        if (i + SW_PREFETCH < n && t->ctrl != NULL)
+        {
+            size_t ahead = sw_start(t, sw_hash(keys[i + SW_PREFETCH]));
+            __builtin_prefetch(&t->ctrl[ahead], 1);
+            __builtin_prefetch(&t->keys[ahead], 1);
+        }
+        if (!sw_add(t, keys[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// sw_add in the shape ingest calls it
+bool sw_ingest(void *t, int number)
+{
+    return sw_add(t, number);
+}
+
+// Returns the allocation counters of the table
+memstats *sw_memory(swtable *t)
+{
+    return &t->mem;
+}
+
+// Searches for a number and deletes it if found, the benchmark's fused operation
+bool sw_search(swtable *t, int numbers)
+{
+    return sw_remove(t, numbers);
+}
+
+// Returns true if number is in the table, leaving the table untouched
+bool sw_contains(swtable *t, int number)
+{
+    size_t slot;
+    return t->ctrl != NULL && sw_find(t, number, &slot);
+}
+
+// Looks up n numbers, setting found[i] for each, and returns how many were found
+// The first group of a group of SW_GROUP keys is prefetched, control bytes
+// and keys, before any of them is probed, so their cache misses overlap
+size_t sw_contains_batch(swtable *t, const int *keys, size_t n, bool *found)
+{
+    size_t hits = 0;
+    for (size_t base = 0; base < n; base += SW_GROUP)
+    {
+        size_t group = (n - base < SW_GROUP) ? n - base : SW_GROUP;
+        if (t->ctrl != NULL)
+        {
+            for (size_t j = 0; j < group; j++)
+            {
+                size_t start = sw_start(t, sw_hash(keys[base + j]));
+                __builtin_prefetch(&t->ctrl[start]);
+                __builtin_prefetch(&t->keys[start]);
+            }
+        }
+        for (size_t j = 0; j < group; j++)
+        {
+            found[base + j] = sw_contains(t, keys[base + j]);
+            hits += found[base + j];
+        }
+    }
+    return hits;
+}
+
+// Deletes number from the table, returning false if it wasn't there
+bool sw_remove(swtable *t, int number)
+{
+    size_t slot;
+    if (t->ctrl == NULL || !sw_find(t, number, &slot))
+    {
+        return false;
+    }
+
+    // a probe only moves past a full group, so the slot can go back to
+    // empty if its group has an empty slot, else it must stay a tombstone
+    const uint8_t *group = &t->ctrl[slot & ~(size_t) (SW_GROUP_WIDTH - 1)];
+    if (sw_match(group, SW_EMPTY) != 0)
+    {
+        t->ctrl[slot] = SW_EMPTY;
+        t->growth++;
+    }
+    else
+    {
+        t->ctrl[slot] = SW_DELETED;
+    }
+    t->count--;
+    return true;
+}
+
+// Frees both arrays, leaving an empty table
+void sw_unload(swtable *t)
+{
+    if (t->ctrl != NULL)
+    {
+        mem_free(&t->mem, t->ctrl, t->capacity);
+        mem_free(&t->mem, t->keys, t->capacity * sizeof(int));
+    }
+    t->ctrl = NULL;
+    t->keys = NULL;
+    t->capacity = 0;
+    t->count = 0;
+    t->growth = 0;
+}
+
+// 64-bit hash of a number: number * 2^64 / Phi (golden number)
+// Bits 32 and up pick the first group, bits 25 to 31 go in the control byte
+uint64_t sw_hash(int number)
+{
+    return (uint64_t) (uint32_t) number * 0x9E3779B97F4A7C15ull;
+}
+
+// First slot of the group a hash starts probing at
+size_t sw_start(const swtable *t, uint64_t hash)
+{
+    size_t groups = t->capacity / SW_GROUP_WIDTH;
+    return (size_t) (((hash >> 32) * groups) >> 32) * SW_GROUP_WIDTH;
+}
+
+// Returns a bit mask of the control bytes of a group that equal byte
+uint32_t sw_match(const uint8_t *group, uint8_t byte)
+{
+#if defined(__SSE2__)
+    __m128i ctrl = _mm_loadu_si128((const __m128i *) group);
+    return (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char) byte)));
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < SW_GROUP_WIDTH; i++)
+    {
+        mask |= (uint32_t) (group[i] == byte) << i;
+    }
+    return mask;
+#endif
+}
+
+// Returns a bit mask of the empty and deleted slots of a group, the only
+// control bytes with the top bit set
+uint32_t sw_unused(const uint8_t *group)
+{
+#if defined(__SSE2__)
+    return (uint32_t) _mm_movemask_epi8(_mm_loadu_si128((const __m128i *) group));
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < SW_GROUP_WIDTH; i++)
+    {
+        mask |= (uint32_t) (group[i] >> 7) << i;
+    }
+    return mask;
+#endif
+}
+
+// Finds the slot holding number, returning false at the first group with an empty slot
+bool sw_find(const swtable *t, int number, size_t *slot)
+{
+    uint64_t hash = sw_hash(number);
+    uint8_t fragment = (uint8_t) ((hash >> 25) & 0x7F);
+    size_t mask = t->capacity - 1;
+    size_t start = sw_start(t, hash);
+
+    for (size_t step = 1; ; step++)
+    {
+        const uint8_t *group = &t->ctrl[start];
+        for (uint32_t match = sw_match(group, fragment); match != 0; match &= match - 1)
+        {
+            size_t i = start + (size_t) __builtin_ctz(match);
+            if (t->keys[i] == number)
+            {
+                *slot = i;
+                return true;
+            }
+        }
+        if (sw_match(group, SW_EMPTY) != 0)
+        {
+            return false;
+        }
+        start = (start + step * SW_GROUP_WIDTH) & mask;
+    }
+}
+
+// Returns the first empty or deleted slot along the probe of a hash
+size_t sw_free_slot(const swtable *t, uint64_t hash)
+{
+    size_t mask = t->capacity - 1;
+    size_t start = sw_start(t, hash);
+
+    for (size_t step = 1; ; step++)
+    {
+        uint32_t unused = sw_unused(&t->ctrl[start]);
+        if (unused != 0)
+        {
+            return start + (size_t) __builtin_ctz(unused);
+        }
+        start = (start + step * SW_GROUP_WIDTH) & mask;
+    }
+}
+
+// Moves every number into new arrays of capacity slots, dropping the
+// tombstones, returning false if out of memory
+bool sw_resize(swtable *t, size_t capacity)
+{
+    uint8_t *ctrl = mem_alloc(&t->mem, capacity);
+    int *keys = mem_alloc(&t->mem, capacity * sizeof(int));
+    if (ctrl == NULL || keys == NULL)
+    {
+        if (ctrl != NULL)
+        {
+            mem_free(&t->mem, ctrl, capacity);
+        }
+        if (keys != NULL)
+        {
+            mem_free(&t->mem, keys, capacity * sizeof(int));
+        }
+        return false;
+    }
+    memset(ctrl, SW_EMPTY, capacity);
+
+    uint8_t *oldCtrl = t->ctrl;
+    int *oldKeys = t->keys;
+    size_t oldCapacity = t->capacity;
+    t->ctrl = ctrl;
+    t->keys = keys;
+    t->capacity = capacity;
+
+    for (size_t i = 0; i < oldCapacity; i++)
+    {
+        if (oldCtrl[i] < SW_EMPTY)
+        {
+            size_t slot = sw_free_slot(t, sw_hash(oldKeys[i]));
+            ctrl[slot] = oldCtrl[i];
+            keys[slot] = oldKeys[i];
+        }
+    }
+
+    if (oldCtrl != NULL)
+    {
+        mem_free(&t->mem, oldCtrl, oldCapacity);
+        mem_free(&t->mem, oldKeys, oldCapacity * sizeof(int));
+    }
+    t->growth = (size_t) (capacity * sw_max_load) - t->count;
+    return true;
+}
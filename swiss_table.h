@@ -0,0 +1,38 @@
+#ifndef SWISS_TABLE_H
+#define SWISS_TABLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ingest.h"
+#include "memory.h"
+
+// Slots probed together, one control byte each
+#define SW_GROUP_WIDTH 16
+
+// Smallest table, in slots (a power of two, and a whole number of groups)
+#define SW_MIN_CAPACITY 1024
+
+// Default share of slots used or deleted before the table is rebuilt
+#define SW_MAX_LOAD 0.875
+
+// A Swiss table (SIMD control-byte hash table), only handled through the functions below
+typedef struct swtable swtable;
+
+swtable *sw_create(void);
+void sw_destroy(swtable *t);
+bool sw_load(double load);
+bool sw_insert(swtable *t, const char *data_file);
+bool sw_add(swtable *t, int number);
+bool sw_add_batch(swtable *t, const int *keys, size_t n);
+memstats *sw_memory(swtable *t);
+bool sw_search(swtable *t, int numbers);
+bool sw_contains(swtable *t, int number);
+size_t sw_contains_batch(swtable *t, const int *keys, size_t n, bool *found);
+bool sw_remove(swtable *t, int number);
+void sw_unload(swtable *t);
+
+#endif
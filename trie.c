@@ -7,97 +7,151 @@
 
 #include "trie.h"
 
-// Function prototypes
-void list_build(int digit);
-struct trienode *trie_delete(trienode* root, listnode* head);
-struct trienode* trie_free(trienode* root);
-void list_free(void);
+// Lookups a batch runs side by side
+#define TRIE_GROUP 16
 
-// Global Variables
-listnode *listhead = NULL;
-trienode *trieroot = NULL;
+// Everything one trie owns
+struct trie
+{
+    trienode *root;
+    // digits of the number being added or searched
+    listnode *list;
+    // memory held by the trie, including the digit lists
+    memstats mem;
+};
 
-bool trie_insert(const char *data_file)
+// Function prototypes
+bool trie_ingest(void *t, int number);
+void list_build(trie *t, int digit);
+struct trienode *trie_delete(trie *t, trienode* root, listnode* head, bool *removed);
+struct trienode* trie_free(trie *t, trienode* root);
+void list_free(trie *t);
+
+// Creates an empty trie, returning NULL if out of memory
+trie *trie_create(void)
 {
-    // open data file
-    FILE *inptr = fopen(data_file, "r");
-    if (inptr == NULL)
+    return calloc(1, sizeof(trie));
+}
+
+// Frees the trie and every number left in it
+void trie_destroy(trie *t)
+{
+    if (t != NULL)
     {
-        printf("Could not open %s.\n", data_file);
-        return false;
+        trie_unload(t);
+        free(t);
     }
+}
+
+bool trie_insert(trie *t, const char *data_file)
+{
+    mem_reset(&t->mem);
 
-    trieroot = calloc(1, sizeof(trienode));
-    if (trieroot == NULL)
+    if (!ingest(data_file, trie_ingest, t))
     {
-        fclose(inptr);
+        trie_unload(t);
         return false;
     }
+    return true;
+}
 
-    // create a buffer
-    int buffer;
-
-    // Build list until reach the end of file
-    while(fscanf(inptr, "%i", &buffer) != EOF)
+// Adds a single number to the trie, returning false if out of memory
+bool trie_add(trie *t, int number)
+{
+    // the root is created with the first number
+    if (t->root == NULL)
     {
-        // store each digit in a linked list
-        list_build(buffer);
+        t->root = mem_calloc(&t->mem, 1, sizeof(trienode));
+        if (t->root == NULL)
+        {
+            return false;
+        }
+    }
 
-        listnode *cursor = listhead;
-        trienode *n = trieroot;
+    // store each digit in a linked list
+    list_build(t, number);
+
+    listnode *cursor = t->list;
+    trienode *n = t->root;
 
-        // load the list to the trie array
-        while (listhead != NULL)
+    // load the list to the trie array
+    while (t->list != NULL)
+    {
+        trienode *next = NULL;
+        // if node doesn't exist for that number, create it
+        if (n->number[cursor->digit] == NULL)
         {
-            trienode *next = NULL;
-            // if node doesn't exist for that number, create it
-            if (n->number[cursor->digit] == NULL)
+            next = mem_calloc(&t->mem, 1, sizeof(trienode));
+            if (next == NULL)
             {
-                next = calloc(1, sizeof(trienode));
-                if (next == NULL)
-                {
-                    trie_unload();
-                    fclose(inptr);
-                    return false;
-                }
-
-                // assign the new address to the digit
-                n->number[cursor->digit] = next;
-                // move n to the next value of the trie
-                n = next;
+                return false;
             }
 
-            // if node already exists
-            else
-            {
-                // assign n to the address for that digit
-                n = n->number[cursor->digit];
-            }
+            // assign the new address to the digit
+            n->number[cursor->digit] = next;
+            // move n to the next value of the trie
+            n = next;
+        }
 
-            // if node is at the end of the list
-            if (cursor->next == NULL)
-            {
-                // set the end of number flag to true
-                n->end = true;
-                break;
-            }
+        // if node already exists
+        else
+        {
+            // assign n to the address for that digit
+            n = n->number[cursor->digit];
+        }
 
-            // move down the linked list
-            cursor = cursor->next;
+        // if node is at the end of the list
+        if (cursor->next == NULL)
+        {
+            // set the end of number flag to true
+            n->end = true;
+            break;
         }
+
+        // move down the linked list
+        cursor = cursor->next;
     }
+    return true;
+}
 
-    // Close the data file
-    fclose(inptr);
+// Adds n numbers, returning false if out of memory
+// Inserts share the trie's digit list, so they run one by one
+bool trie_add_batch(trie *t, const int *keys, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        if (!trie_add(t, keys[i]))
+        {
+            return false;
+        }
+    }
     return true;
 }
 
-bool trie_search(int numbers)
+// trie_add in the shape ingest calls it
+bool trie_ingest(void *t, int number)
 {
+    return trie_add(t, number);
+}
+
+// Returns the allocation counters of the trie
+memstats *trie_memory(trie *t)
+{
+    return &t->mem;
+}
+
+bool trie_search(trie *t, int numbers)
+{
+    // every number has already been deleted
+    if (t->root == NULL)
+    {
+        return false;
+    }
+
     // store each digit in a linked list
-    list_build(numbers);
-    trienode *n = trieroot;
-    listnode *current = listhead;
+    list_build(t, numbers);
+    trienode *n = t->root;
+    listnode *current = t->list;
 
     // while not at the end of the list
     while (current != NULL)
@@ -113,20 +167,21 @@ bool trie_search(int numbers)
                 if (n->end == true)
                 {
                     // reset the cursor
-                    current = listhead;
+                    current = t->list;
                     // delete the number from the TRIE
-                    trieroot = trie_delete(trieroot, current);
+                    bool removed;
+                    t->root = trie_delete(t, t->root, current, &removed);
                     return true;
                 }
                 else
                 {
-                    list_free();
+                    list_free(t);
                     return false;
                 }
             }
             else
             {
-                list_free();
+                list_free(t);
                 return false;
             }
         }
@@ -141,71 +196,172 @@ bool trie_search(int numbers)
         // if not at the end and the pointer doesn't exist
         else
         {
-            list_free();
+            list_free(t);
             // return number not found
             return false;
         }
     }
-    list_free();
+    list_free(t);
     return false;
 }
 
+// Returns true if number is in the trie, leaving the trie untouched
+bool trie_contains(trie *t, int number)
+{
+    if (t->root == NULL)
+    {
+        return false;
+    }
+
+    // follow the digits down as far as the trie goes
+    list_build(t, number);
+    trienode *n = t->root;
+    for (listnode *cursor = t->list; cursor != NULL && n != NULL; cursor = cursor->next)
+    {
+        n = n->number[cursor->digit];
+    }
+
+    bool found = (t->list != NULL && n != NULL && n->end);
+    list_free(t);
+    return found;
+}
+
+// Looks up n numbers, setting found[i] for each, and returns how many were found
+// Groups of TRIE_GROUP lookups walk down the trie in lockstep, one digit at
+// a time, each prefetching its next node so their cache misses overlap
+// Digits are kept on the stack rather than in the digit list
+size_t trie_contains_batch(trie *t, const int *keys, size_t n, bool *found)
+{
+    size_t hits = 0;
+    for (size_t base = 0; base < n; base += TRIE_GROUP)
+    {
+        size_t group = (n - base < TRIE_GROUP) ? n - base : TRIE_GROUP;
+        trienode *cursor[TRIE_GROUP];
+        int digits[TRIE_GROUP][10];
+        int next[TRIE_GROUP];
+
+        // the last digit comes out first, so each lookup starts at the end
+        for (size_t j = 0; j < group; j++)
+        {
+            next[j] = -1;
+            for (int number = keys[base + j]; number > 0; number /= 10)
+            {
+                digits[j][++next[j]] = number % 10;
+            }
+            cursor[j] = (next[j] >= 0) ? t->root : NULL;
+            found[base + j] = false;
+        }
+
+        // move every lookup still running one digit down
+        bool running = true;
+        while (running)
+        {
+            running = false;
+            for (size_t j = 0; j < group; j++)
+            {
+                if (cursor[j] == NULL)
+                {
+                    continue;
+                }
+
+                trienode *c = cursor[j]->number[digits[j][next[j]--]];
+                if (c != NULL && next[j] < 0)
+                {
+                    found[base + j] = c->end;
+                    hits += c->end;
+                    c = NULL;
+                }
+                else if (c != NULL)
+                {
+                    __builtin_prefetch(c);
+                    running = true;
+                }
+                cursor[j] = c;
+            }
+        }
+    }
+    return hits;
+}
+
+// Deletes number from the trie in a single descent, returning false if it wasn't there
+// (trie_search walks the digits first and then descends again to delete them)
+bool trie_remove(trie *t, int number)
+{
+    if (t->root == NULL)
+    {
+        return false;
+    }
+
+    list_build(t, number);
+    bool removed = false;
+    if (t->list != NULL)
+    {
+        t->root = trie_delete(t, t->root, t->list, &removed);
+    }
+    list_free(t);
+    return removed;
+}
+
 // Call the function to unload the trie from memory
-void trie_unload(void)
+void trie_unload(trie *t)
 {
-    trieroot = trie_free(trieroot);
+    // the root itself is freed once the last number is deleted
+    if (t->root != NULL)
+    {
+        t->root = trie_free(t, t->root);
+    }
 
     // free the linked list
-    list_free();
+    list_free(t);
 }
 
 // Frees the entire Trie from memory
-struct trienode* trie_free(trienode* root)
+struct trienode* trie_free(trie *t, trienode* root)
 {
         // recursively check each children
         for (int i = 0; i <= 9; i++)
         {
             if (root->number[i] != NULL)
             {
-                root->number[i] = trie_free(root->number[i]);
+                root->number[i] = trie_free(t, root->number[i]);
             }
         }
 
         // all children from that adress are null
         // then free it from memory
-        free(root);
+        mem_free(&t->mem, root, sizeof(trienode));
 
         return NULL;
 }
 
 // Create a prepending linked list with the digits of the number freeing the previous one from memory
-void list_build(int number)
+void list_build(trie *t, int number)
 {
     // Frees previous list allocation
-    list_free();
+    list_free(t);
     // store each digit in a linked list
     while (number > 0)
     {
         int digit = number % 10;
         // create a linked list with prepending digits
-        listnode *n = malloc(sizeof(listnode));
+        listnode *n = mem_alloc(&t->mem, sizeof(listnode));
         if (n == NULL)
         {
-            list_free();
+            list_free(t);
             return;
         }
         n->digit = digit;
         n->next = NULL;
 
         // if list is empty
-        if (listhead == NULL)
+        if (t->list == NULL)
         {
-            listhead = n;
+            t->list = n;
         }
         else
         {
-            n->next = listhead;
-            listhead = n;
+            n->next = t->list;
+            t->list = n;
         }
         number /= 10;
     }
@@ -213,28 +369,41 @@ void list_build(int number)
 }
 
 // Free the list from memory
-void list_free(void)
+void list_free(trie *t)
 {
     // If a list exists, clear it
-    while (listhead != NULL)
+    while (t->list != NULL)
     {
-        listnode *temp = listhead->next;
-        free(listhead);
-        listhead = temp;
+        listnode *temp = t->list->next;
+        mem_free(&t->mem, t->list, sizeof(listnode));
+        t->list = temp;
     }
-    // set listhead back to null
-    listhead = NULL;
+    // set the list back to null
+    t->list = NULL;
 }
 
-// Delete a number from the trie
-struct trienode *trie_delete(trienode* root, listnode* head)
+// Delete a number from the trie, setting removed if the number was found
+struct trienode *trie_delete(trie *t, trienode* root, listnode* head, bool *removed)
 {
+    // if the number isn't in the trie
+    if (root == NULL)
+    {
+        return NULL;
+    }
+
     // if at the end of the digit list
     if (head->next == NULL)
     {
         trienode* child = root->number[head->digit];
+        // a prefix of other numbers, or nothing at all
+        if (child == NULL || !child->end)
+        {
+            return root;
+        }
+
         // set the end flag to false
         child->end = false;
+        *removed = true;
 
         // Check if the child has children
         for (int i = 0; i <= 9; i++)
@@ -246,14 +415,14 @@ struct trienode *trie_delete(trienode* root, listnode* head)
         }
 
         // If no children, remove the node
-        free(child);
+        mem_free(&t->mem, child, sizeof(trienode));
         root->number[head->digit] = NULL;
     }
 
     // Recursively moves onto the next digit
     else
     {
-        root->number[head->digit] = trie_delete(root->number[head->digit], head->next);
+        root->number[head->digit] = trie_delete(t, root->number[head->digit], head->next, removed);
     }
 
     // check if the node has children
@@ -267,7 +436,7 @@ struct trienode *trie_delete(trienode* root, listnode* head)
     // if the root isn't an endpoint
     if (!root->end)
     {
-        free(root);
+        mem_free(&t->mem, root, sizeof(trienode));
         return NULL;
     }
 
@@ -5,6 +5,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "ingest.h"
+#include "memory.h"
+
 // Represents a node in a trie
 typedef struct trienode
 {
@@ -18,8 +21,19 @@ typedef struct listnode
     struct listnode *next;
 } listnode;
 
-bool trie_insert(const char *data_file);
-bool trie_search(int numbers);
-void trie_unload(void);
+// A trie, only handled through the functions below
+typedef struct trie trie;
+
+trie *trie_create(void);
+void trie_destroy(trie *t);
+bool trie_insert(trie *t, const char *data_file);
+bool trie_add(trie *t, int number);
+bool trie_add_batch(trie *t, const int *keys, size_t n);
+memstats *trie_memory(trie *t);
+bool trie_search(trie *t, int numbers);
+bool trie_contains(trie *t, int number);
+size_t trie_contains_batch(trie *t, const int *keys, size_t n, bool *found);
+bool trie_remove(trie *t, int number);
+void trie_unload(trie *t);
 
 #endif